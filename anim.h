@@ -2,11 +2,14 @@
 #define __ANIM_H__
 #include <SDL.h>
 
-void anim_load_frame(SDL_Rect *frame, const int size, const int framenum)
+void anim_load_frame(SDL_Rect *frame, const SDL_Rect *frame_rect, const int framenum)
 { // Load frame rect with rectangle that bounds the current animation frame
-    int col = (framenum-1) % 8;                             // col 0 is frame 1, col 7 is frame 8
-    int row = (int)((framenum-1)/8);                        // row 0 has frames 1 to 8
-    frame->x = col*size; frame->y = row*size;
+    /* *************DOC***************
+     * frame_rect : table of frame rects, frame_rect[0] is frame 1
+     *              (rects are in the sprite sheet or in the atlas)
+     * framenum   : frame number to load
+     * *******************************/
+    *frame = frame_rect[framenum-1];
 }
 void anim_prev_frame(int *framenum, const int framecnt)
 { // Load previous frame number
@@ -0,0 +1,300 @@
+#ifndef __ANIMS_H__
+#define __ANIMS_H__
+/* *************Animation system***************
+ * Animation state for many characters, as a structure of arrays.
+ *
+ * A Sprite is the sprite sheet (a clip): frames, frame count, speed.
+ * An instance is one character playing a clip: position, frame
+ * number, tick count, direction. Instances share clips, so a crowd
+ * of penguins animates independently from one sprite sheet.
+ *
+ * Each field is its own array: anims.x[i] is the x of instance i.
+ * anims_tick() advances every instance in one loop over plain int
+ * and float arrays (no pointer chasing, no branches), which the
+ * compiler vectorizes.
+ *
+ * A clip whose layout gives per-frame durations (Sprite frame_ms, see
+ * layout.h) changes ticks_per_frame on every frame. Those instances
+ * get a second, short pass after the main loop.
+ *
+ * anims_tick() never reads a Sprite: each clip's timing (frame count,
+ * speed, durations) is copied to an AnimClip when the clip is added
+ * and when its sheet is (re)loaded (anims_clip_changed). So it can
+ * run on another thread while the main thread reloads sheets (see
+ * sim.h). clips[] is only for drawing, on the main thread.
+ *
+ * Example:
+ *      AnimSystem anims; anims_init(&anims, 16);
+ *      int clip_PI = anims_add_clip(&anims, sprite_PI);
+ *      int penguin = anims_add(&anims, clip_PI, 100, 100);
+ *      ...
+ *      anims_tick(&anims);                             // Every game loop tick
+ *      anims_draw(&anims, &batch, 0);                  // Queue every instance
+ *      ...
+ *      anims_free(&anims);
+ * *******************************/
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <SDL.h>
+#include "anim.h"
+#include "sprite.h"
+#include "batch.h"
+#include "pacing.h"
+
+#define ANIMS_MAX_CLIPS 64
+
+typedef struct
+{ // What anims_tick needs from a clip's Sprite, copied
+    int framecnt;
+    int ticks_per_frame;
+    bool has_durations;                 // frame_ms[] is set, else every frame lasts ticks_per_frame
+    int frame_ms[SPRITE_MAX_FRAMES];    // How long frame n shows : frame_ms[n-1], 0 : ticks_per_frame
+} AnimClip;
+
+typedef struct
+{
+    int n;                              // Number of instances
+    int cap;                            // Room for this many instances
+    // Per-instance state
+    float *x, *y;                       // Position : top-left of rendered frame
+    float *prev_x, *prev_y;             // Position at the previous tick (to interpolate)
+    float *vx;                          // Pixels to move per tick
+    int *clip;                          // Index into clips[]
+    int *framenum;                      // Current frame number : 1 to framecnt
+    int *tick;                          // Ticks spent on the current frame
+    int *dir;                           // 1 : face right, -1 : face left
+    int *scale;                         // Scale frame by this amount
+    // Copied from the clip when the clip is set, so anims_tick() only reads arrays
+    int *framecnt;
+    int *ticks_per_frame;
+    // Clips
+    Sprite *clips[ANIMS_MAX_CLIPS];     // Sheets to draw (main thread only)
+    AnimClip *timing;                   // timing[c] : copy of clip c's timing (heap : AnimClip is big)
+    int nclips;
+} AnimSystem;
+
+void anims_clip_from_sprite(AnimClip *clip, const Sprite *sprite)
+{ // Copy the timing of sprite
+    clip->framecnt = sprite->framecnt;
+    clip->ticks_per_frame = sprite->ticks_per_frame;
+    clip->has_durations = sprite->has_durations;
+    memcpy(clip->frame_ms, sprite->frame_ms, sizeof(clip->frame_ms));
+}
+
+void anims_free(AnimSystem *anims)
+{
+    free(anims->x); free(anims->y); free(anims->prev_x); free(anims->prev_y); free(anims->vx);
+    free(anims->clip); free(anims->framenum); free(anims->tick); free(anims->dir);
+    free(anims->scale); free(anims->framecnt); free(anims->ticks_per_frame); free(anims->timing);
+    *anims = (AnimSystem){0};
+}
+
+int anims_reserve(AnimSystem *anims, int cap)
+{ // Make room for cap instances. Return -1 if out of memory.
+    if(  cap <= anims->cap  ) return 0;
+    #define ANIMS_GROW(field)                                               \
+    {                                                                       \
+        void *p = realloc(anims->field, cap*sizeof(*anims->field));         \
+        if(  p == NULL  ) return -1;                                        \
+        anims->field = p;                                                   \
+    }
+    ANIMS_GROW(x); ANIMS_GROW(y); ANIMS_GROW(prev_x); ANIMS_GROW(prev_y); ANIMS_GROW(vx);
+    ANIMS_GROW(clip); ANIMS_GROW(framenum); ANIMS_GROW(tick); ANIMS_GROW(dir);
+    ANIMS_GROW(scale); ANIMS_GROW(framecnt); ANIMS_GROW(ticks_per_frame);
+    #undef ANIMS_GROW
+    anims->cap = cap;
+    return 0;
+}
+
+int anims_init(AnimSystem *anims, int cap)
+{
+    *anims = (AnimSystem){0};
+    return anims_reserve(anims, cap);
+}
+
+int anims_copy(AnimSystem *dst, const AnimSystem *src)
+{ // Copy every instance and clip of src to dst (e.g., a snapshot). Return -1 if out of memory.
+    if(  anims_reserve(dst, src->n) < 0  ) return -1;
+    int n = src->n;
+    #define ANIMS_COPY(field) memcpy(dst->field, src->field, n*sizeof(*src->field))
+    ANIMS_COPY(x); ANIMS_COPY(y); ANIMS_COPY(prev_x); ANIMS_COPY(prev_y); ANIMS_COPY(vx);
+    ANIMS_COPY(clip); ANIMS_COPY(framenum); ANIMS_COPY(tick); ANIMS_COPY(dir);
+    ANIMS_COPY(scale); ANIMS_COPY(framecnt); ANIMS_COPY(ticks_per_frame);
+    #undef ANIMS_COPY
+    dst->n = n;
+    if(  (dst->timing == NULL) || (dst->nclips < src->nclips)  )
+    {
+        void *p = realloc(dst->timing, (src->nclips > 0 ? src->nclips : 1)*sizeof(AnimClip));
+        if(  p == NULL  ) return -1;
+        dst->timing = p;
+    }
+    memcpy(dst->timing, src->timing, src->nclips*sizeof(AnimClip));
+    memcpy(dst->clips, src->clips, sizeof(src->clips));
+    dst->nclips = src->nclips;
+    return 0;
+}
+
+int anims_add_clip(AnimSystem *anims, Sprite *sprite)
+{ // Register a sprite sheet as a clip. Return the clip index, or -1 if full or out of memory.
+    if(  anims->nclips == ANIMS_MAX_CLIPS  ) return -1;
+    AnimClip *timing = realloc(anims->timing, (anims->nclips + 1)*sizeof(AnimClip));
+    if(  timing == NULL  ) return -1;
+    anims->timing = timing;
+    anims->clips[anims->nclips] = sprite;
+    anims_clip_from_sprite(&anims->timing[anims->nclips], sprite);
+    return anims->nclips++;
+}
+
+int anims_frame_ticks(const AnimSystem *anims, int i)
+{ // ticks_per_frame for the current frame of instance i
+    const AnimClip *clip = &anims->timing[anims->clip[i]];
+    int ms = clip->has_durations ? clip->frame_ms[anims->framenum[i]-1] : 0;
+    if(  ms <= 0  ) return clip->ticks_per_frame;
+    int ticks = (ms*PACING_SIM_HZ + 500)/1000;                  // A frame shows for ticks_per_frame+1 ticks
+    return (ticks > 1) ? ticks-1 : 0;
+}
+
+void anims_set_clip(AnimSystem *anims, int i, int clip)
+{ // Play clip from its first frame. Does nothing if instance i is already playing clip.
+    if(  anims->clip[i] == clip  ) return;
+    anims->clip[i] = clip;
+    anims->framenum[i] = 1;
+    anims->tick[i] = 0;
+    anims->framecnt[i] = anims->timing[clip].framecnt;
+    anims->ticks_per_frame[i] = anims_frame_ticks(anims, i);
+}
+
+void anims_clip_changed(AnimSystem *anims, int clip, const AnimClip *timing)
+{ // The sheet of clip was (re)loaded with timing: copy it to the clip and every instance playing it
+    /* *************DOC***************
+     * timing is a copy (see anims_clip_from_sprite), made where the
+     * sheet was loaded: the Sprite is never read here.
+     * *******************************/
+    anims->timing[clip] = *timing;
+    for( int i=0; i<anims->n; i++ )
+    {
+        if(  anims->clip[i] != clip  ) continue;
+        anims->framecnt[i] = timing->framecnt;
+        if(  anims->framenum[i] > timing->framecnt  ) anims->framenum[i] = 1;
+        anims->ticks_per_frame[i] = anims_frame_ticks(anims, i);
+    }
+}
+
+int anims_add(AnimSystem *anims, int clip, float x, float y)
+{ // Add an instance playing clip at x,y. Return the instance index, or -1 if out of memory.
+    if(  (anims->n == anims->cap) && (anims_reserve(anims, (anims->cap > 0) ? 2*anims->cap : 16) < 0)  ) return -1;
+    int i = anims->n++;
+    anims->x[i] = x; anims->y[i] = y; anims->vx[i] = 0;
+    anims->prev_x[i] = x; anims->prev_y[i] = y;
+    anims->dir[i] = 1;
+    anims->scale[i] = anims->clips[clip]->scale;
+    anims->clip[i] = -1;                                        // Force anims_set_clip to load the clip
+    anims_set_clip(anims, i, clip);
+    return i;
+}
+
+void anims_tick(AnimSystem *anims)
+{ // Advance every instance by one game loop tick
+    /* *************DOC***************
+     * Same rule as the old per-sprite code: stay on a frame for
+     * ticks_per_frame ticks, then go to the next frame (after the
+     * last frame, go back to frame 1).
+     * *******************************/
+    int n = anims->n;
+    memcpy(anims->prev_x, anims->x, n*sizeof(float));          // Interpolate from here
+    memcpy(anims->prev_y, anims->y, n*sizeof(float));
+    float *restrict x = anims->x;
+    const float *restrict vx = anims->vx;
+    int *restrict framenum = anims->framenum;
+    int *restrict tick = anims->tick;
+    const int *restrict framecnt = anims->framecnt;
+    const int *restrict ticks_per_frame = anims->ticks_per_frame;
+    for( int i=0; i<n; i++ )
+    {
+        int advance = (tick[i] >= ticks_per_frame[i]);          // 1 : time for the next frame
+        tick[i] = advance ? 0 : tick[i]+1;
+        int f = framenum[i] + advance;
+        framenum[i] = (f > framecnt[i]) ? 1 : f;                // Wrap to frame 1
+        x[i] += vx[i];
+    }
+    for( int i=0; i<n; i++ )
+    { // Per-frame durations: speed of the (maybe new) current frame
+        if(  anims->timing[anims->clip[i]].has_durations  ) anims->ticks_per_frame[i] = anims_frame_ticks(anims, i);
+    }
+}
+
+int anims_next_change(const AnimSystem *anims)
+{ // Ticks until an instance shows another frame or moves (1 : next tick). INT_MAX if none will.
+    /* *************DOC***************
+     * Same rule as anims_tick: an instance advances on the tick that
+     * finds tick >= ticks_per_frame, so ticks_per_frame - tick + 1
+     * ticks from now.
+     * *******************************/
+    int next = INT_MAX;
+    for( int i=0; i<anims->n; i++ )
+    {
+        if(  anims->vx[i] != 0  ) return 1;                    // Moves every tick
+        if(  anims->framecnt[i] <= 1  ) continue;               // Never shows another frame
+        int wait = anims->ticks_per_frame[i] - anims->tick[i] + 1;
+        if(  wait < 1  ) wait = 1;
+        if(  wait < next  ) next = wait;
+    }
+    return next;
+}
+
+void anims_place(AnimSystem *anims, int i, float x, float y)
+{ // Move instance i to x,y without interpolating from the old position
+    anims->x[i] = x; anims->y[i] = y;
+    anims->prev_x[i] = x; anims->prev_y[i] = y;
+}
+
+void anims_step_frame(AnimSystem *anims, int i, int step)
+{ // Go forward (step=1) or back (step=-1) one frame, e.g., to inspect frames
+    if(  step > 0  ) anim_next_frame(&anims->framenum[i], anims->framecnt[i]);
+    else             anim_prev_frame(&anims->framenum[i], anims->framecnt[i]);
+    anims->ticks_per_frame[i] = anims_frame_ticks(anims, i);
+}
+
+const SDL_Rect *anims_frame(const AnimSystem *anims, int i)
+{ // Frame rect (in the clip's texture) for the current frame of instance i
+    return &anims->clips[anims->clip[i]]->frame_rect[anims->framenum[i]-1];
+}
+
+SDL_Rect anims_render_rect(const AnimSystem *anims, int i, float alpha)
+{ // Size and location of instance i on the screen, alpha of the way from the previous tick
+    /* *************DOC***************
+     * x,y is the top-left of the whole (untrimmed) frame. The rect
+     * returned only covers the trimmed frame: it is moved by the
+     * frame's pivot offset, mirrored when the instance faces left.
+     * *******************************/
+    const Sprite *sprite = anims->clips[anims->clip[i]];
+    const SDL_Rect *frame = anims_frame(anims, i);
+    SDL_Point off = sprite->frame_offset[anims->framenum[i]-1];
+    int ox = (anims->dir[i] == 1) ? off.x : sprite->frame_w - off.x - frame->w;
+    int scale = anims->scale[i];
+    float x = anims->prev_x[i] + alpha*(anims->x[i] - anims->prev_x[i]);
+    float y = anims->prev_y[i] + alpha*(anims->y[i] - anims->prev_y[i]);
+    return (SDL_Rect){.x=(int)x + scale*ox, .y=(int)y + scale*off.y,
+                      .w=scale*frame->w, .h=scale*frame->h};
+}
+
+void anims_draw_clipped(const AnimSystem *anims, SpriteBatch *batch, float alpha, const SDL_Rect *clip)
+{ // Queue every instance that overlaps clip (NULL : every instance) in the batch (alpha : see anims_render_rect)
+    for( int i=0; i<anims->n; i++ )
+    {
+        const Sprite *sprite = anims->clips[anims->clip[i]];
+        if(  sprite->framecnt == 0  ) continue;
+        SDL_Rect render = anims_render_rect(anims, i, alpha);
+        if(  (clip != NULL) && (SDL_HasIntersection(&render, clip) == SDL_FALSE)  ) continue;
+        SDL_RendererFlip flip = (anims->dir[i] == 1) ? SDL_FLIP_NONE : SDL_FLIP_HORIZONTAL;
+        batch_push(batch, sprite->tex, anims_frame(anims, i), &render, flip);
+    }
+}
+
+void anims_draw(const AnimSystem *anims, SpriteBatch *batch, float alpha)
+{ // Queue every instance in the batch (alpha : see anims_render_rect)
+    anims_draw_clipped(anims, batch, alpha, NULL);
+}
+
+#endif // __ANIMS_H__
@@ -0,0 +1,311 @@
+#ifndef __ASSETS_H__
+#define __ASSETS_H__
+/* *************Asset manager***************
+ * Load sprite sheets in the background.
+ *
+ * A pool of worker threads decodes each png and analyzes its frames
+ * (sprite_load_surface, sprite_load_info). Only the texture upload
+ * runs on the main thread (the renderer is not thread-safe). The
+ * game loop starts right away and a character shows up as soon as
+ * its sprite sheet is ready.
+ *
+ * Example:
+ *      AssetManager assets; assets_init(&assets);
+ *      int id = assets_load(&assets, sprite_PI);          // Returns at once
+ *      ...
+ *      while(  quit == false  )
+ *      {
+ *          for( int id; (id = assets_poll(&assets, ren)) >= 0; )
+ *          { // Sheet id is ready (or failed, see assets_state)
+ *              ...
+ *          }
+ *          ...
+ *      }
+ *      assets_free(&assets);
+ *
+ * Until its sheet is ready, a Sprite has framecnt 0 (nothing to draw)
+ * and the default animation state (sprite_init_state).
+ *
+ * Threads: the worker only writes asset->staged and asset->surf, never
+ * the Sprite the game draws. assets_poll (main thread) uploads the
+ * texture and copies the sheet info into the Sprite. asset->state is
+ * the hand-off between the two.
+ * *******************************/
+#include <SDL.h>
+#include "sprite.h"
+#include "atlas.h"
+
+#define ASSETS_MAX 64                   // Max sprite sheets
+#define ASSETS_MAX_WORKERS 4            // Max decode threads
+
+typedef enum
+{
+    ASSET_EMPTY,
+    ASSET_QUEUED,                       // Waiting for a worker
+    ASSET_DECODING,                     // A worker is decoding and analyzing it
+    ASSET_DECODED,                      // Waiting for the main thread to upload it
+    ASSET_READY,                        // Sprite has its texture and frames
+    ASSET_FAILED,                       // Cannot load (message is printed)
+} AssetState;
+
+typedef struct
+{
+    Sprite *sprite;                     // Sprite the game draws (main thread only)
+    Sprite staged;                      // Sheet info found by the worker
+    SDL_Surface *surf;                  // Sheet decoded by the worker
+    SDL_atomic_t state;                 // AssetState
+    bool reported;                      // assets_poll returned the final state already
+    bool reload;                        // Sprite has a sheet already: on error, keep it
+    bool again;                         // File changed during a reload: reload once more
+} Asset;
+
+typedef struct
+{
+    Asset asset[ASSETS_MAX];
+    int n;
+    int queue[ASSETS_MAX];              // Ring of asset ids to decode (an asset is queued at most once)
+    int qhead, qtail;
+    SDL_mutex *lock;                    // Guards queue
+    SDL_sem *work;                      // One post per queued asset
+    SDL_atomic_t quit;
+    SDL_Thread *worker[ASSETS_MAX_WORKERS];
+    int nworkers;                       // 0 : no threads, assets_load decodes right away
+    bool keep_surfaces;                 // Keep decoded sheets after upload (e.g., for an atlas)
+} AssetManager;
+
+void assets_decode(Asset *asset)
+{ // Decode and analyze one sheet (on a worker thread)
+    SDL_AtomicSet(&asset->state, ASSET_DECODING);
+    SDL_Surface *surf = sprite_load_surface(asset->staged.path);
+    if(  surf == NULL  )
+    {
+        SDL_AtomicSet(&asset->state, ASSET_FAILED);
+        return;
+    }
+    sprite_load_info(&asset->staged, surf);
+    asset->surf = surf;
+    SDL_AtomicSet(&asset->state, ASSET_DECODED);               // Publish staged and surf
+}
+
+int assets_worker(void *data)
+{ // Thread function: decode queued assets until assets_free
+    AssetManager *am = data;
+    for(;;)
+    {
+        SDL_SemWait(am->work);
+        if(  SDL_AtomicGet(&am->quit)  ) break;
+        SDL_LockMutex(am->lock);
+        int id = am->queue[am->qhead];
+        am->qhead = (am->qhead + 1) % ASSETS_MAX;
+        SDL_UnlockMutex(am->lock);
+        assets_decode(&am->asset[id]);
+    }
+    return 0;
+}
+
+void assets_init(AssetManager *am)
+{ // Start the workers: one per CPU, minus the main thread
+    SDL_zero(*am);
+    am->lock = SDL_CreateMutex();
+    am->work = SDL_CreateSemaphore(0);
+    if(  (am->lock == NULL) || (am->work == NULL)  ) return;   // No workers: load on the main thread
+    int nworkers = SDL_GetCPUCount() - 1;
+    if(  nworkers > ASSETS_MAX_WORKERS  ) nworkers = ASSETS_MAX_WORKERS;
+    if(  nworkers < 1  ) nworkers = 1;
+    for( int i=0; i<nworkers; i++ )
+    {
+        SDL_Thread *t = SDL_CreateThread(assets_worker, "assets", am);
+        if(  t != NULL  ) am->worker[am->nworkers++] = t;
+    }
+}
+
+void assets_queue(AssetManager *am, int id)
+{ // Hand asset id to a worker
+    Asset *asset = &am->asset[id];
+    free(asset->staged.mask);                                   // Left by a load whose upload failed
+    asset->staged = (Sprite){.path = asset->sprite->path};
+    asset->reported = false;
+    asset->again = false;
+    SDL_AtomicSet(&asset->state, ASSET_QUEUED);
+    if(  am->nworkers == 0  ) { assets_decode(asset); return; }
+    SDL_LockMutex(am->lock);
+    am->queue[am->qtail] = id;
+    am->qtail = (am->qtail + 1) % ASSETS_MAX;
+    SDL_UnlockMutex(am->lock);
+    SDL_SemPost(am->work);
+}
+
+int assets_load(AssetManager *am, Sprite *sprite)
+{ // Start loading sprite->path into sprite. Return the asset id, or -1 if full.
+    if(  am->n == ASSETS_MAX  ) return -1;
+    int id = am->n++;
+    am->asset[id] = (Asset){.sprite = sprite};
+    sprite->framecnt = 0;                                       // Nothing to draw yet
+    sprite_init_state(sprite);
+    assets_queue(am, id);
+    return id;
+}
+
+AssetState assets_state(AssetManager *am, int id)
+{
+    return (AssetState)SDL_AtomicGet(&am->asset[id].state);
+}
+
+int assets_adopt(AssetManager *am, Sprite *sprite)
+{ // Track a sprite that is loaded already (e.g., from a baked atlas), so it can be reloaded
+    if(  am->n == ASSETS_MAX  ) return -1;
+    int id = am->n++;
+    am->asset[id] = (Asset){.sprite = sprite, .reported = true};
+    SDL_AtomicSet(&am->asset[id].state, ASSET_READY);
+    return id;
+}
+
+int assets_find(AssetManager *am, const char *path)
+{ // Return the id of the asset loaded from path, or -1
+    for( int id=0; id<am->n; id++ )
+    {
+        if(  strcmp(am->asset[id].sprite->path, path) == 0  ) return id;
+    }
+    return -1;
+}
+
+void assets_reload(AssetManager *am, int id)
+{ // Decode the sheet again (e.g., the file changed). The sprite keeps its sheet until the new one is ready.
+    Asset *asset = &am->asset[id];
+    AssetState st = assets_state(am, id);
+    if(  st == ASSET_QUEUED  ) return;                          // Worker has not opened the file yet
+    if(  (st == ASSET_DECODING) || (st == ASSET_DECODED)  ) { asset->again = true; return; }
+    asset->reload = (st == ASSET_READY);
+    assets_queue(am, id);
+}
+
+int assets_pending(AssetManager *am)
+{ // Number of assets not ready and not failed
+    int n = 0;
+    for( int id=0; id<am->n; id++ )
+    {
+        AssetState st = assets_state(am, id);
+        if(  (st != ASSET_READY) && (st != ASSET_FAILED)  ) n++;
+    }
+    return n;
+}
+
+void assets_apply(Asset *asset, SDL_Texture *tex, bool shared_tex)
+{ // Give the sprite its new sheet. Keep what the game set (scale, ticks_per_frame).
+    Sprite *sprite = asset->sprite; const Sprite *staged = &asset->staged;
+    sprite->tex = tex;
+    sprite->shared_tex = shared_tex;
+    sprite->sheet_w = staged->sheet_w; sprite->sheet_h = staged->sheet_h;
+    sprite->frame_w = staged->frame_w; sprite->frame_h = staged->frame_h;
+    sprite->size = staged->size;
+    sprite->framecnt = staged->framecnt;
+    sprite->cols = staged->cols; sprite->rows = staged->rows;
+    memcpy(sprite->occupied, staged->occupied, sizeof(sprite->occupied));
+    memcpy(sprite->frame_rect, staged->frame_rect, sizeof(sprite->frame_rect));
+    memcpy(sprite->frame_offset, staged->frame_offset, sizeof(sprite->frame_offset));
+    sprite->has_durations = staged->has_durations;
+    memcpy(sprite->frame_ms, staged->frame_ms, sizeof(sprite->frame_ms));
+    memcpy(sprite->mask_at, staged->mask_at, sizeof(sprite->mask_at)); // The masks move in assets_poll
+    if(  sprite->framenum > sprite->framecnt  ) sprite->framenum = 1;
+    sprite->render.w = sprite->scale*sprite->frame_w;
+    sprite->render.h = sprite->scale*sprite->frame_h;
+    if(  sprite->framecnt > 0  ) sprite->frame = sprite->frame_rect[sprite->framenum-1];
+}
+
+int assets_poll(AssetManager *am, SDL_Renderer *ren)
+{ // Upload one decoded sheet. Return its id, or the id of a failed load, or -1 if nothing changed.
+    /* *************DOC***************
+     * Call in a loop until it returns -1. Each asset id is returned
+     * once per load (and once per reload): check assets_state(am, id)
+     * for ASSET_READY or ASSET_FAILED. A failed reload is not
+     * returned: the sprite keeps the sheet it had.
+     * *******************************/
+    for( int id=0; id<am->n; id++ )
+    {
+        Asset *asset = &am->asset[id];
+        AssetState st = assets_state(am, id);
+        if(  asset->again && asset->reported && ((st == ASSET_READY) || (st == ASSET_FAILED))  )
+        { // File changed again while it was decoding
+            assets_reload(am, id);
+            continue;
+        }
+        if(  st == ASSET_DECODED  )
+        {
+            SDL_Texture *tex = SDL_CreateTextureFromSurface(ren, asset->surf);
+            if(  tex == NULL  )
+            {
+                printf("Failed to create texture for \"%s\": %s\n", asset->staged.path, SDL_GetError());
+                st = ASSET_FAILED;
+            }
+            else
+            {
+                if(  asset->sprite->shared_tex == false  ) SDL_DestroyTexture(asset->sprite->tex);
+                assets_apply(asset, tex, false);
+                free(asset->sprite->mask);                      // New sheet, new masks
+                asset->sprite->mask = asset->staged.mask;
+                asset->staged.mask = NULL;
+                st = ASSET_READY;
+            }
+            if(  (am->keep_surfaces == false) || (st == ASSET_FAILED)  )
+            {
+                SDL_FreeSurface(asset->surf);
+                asset->surf = NULL;
+            }
+            SDL_AtomicSet(&asset->state, st);
+        }
+        if(  ((st != ASSET_READY) && (st != ASSET_FAILED)) || asset->reported  ) continue;
+        asset->reported = true;
+        if(  (st == ASSET_FAILED) && asset->reload  )
+        { // Reload failed (e.g., the file is half written): keep the old sheet, nothing to report
+            printf("Keeping the old \"%s\"\n", asset->sprite->path);
+            SDL_AtomicSet(&asset->state, ASSET_READY);
+            continue;
+        }
+        return id;
+    }
+    return -1;
+}
+
+int assets_pack_atlas(AssetManager *am, Atlas *atlas, SDL_Renderer *ren)
+{ // Move every ready sheet into one atlas texture. Needs keep_surfaces. Return -1 on error.
+    /* *************DOC***************
+     * Call once assets_pending() is 0. On success the per-sheet
+     * textures and the decoded sheets are freed. On error the
+     * sprites keep their per-sheet textures. Either way, sheets are
+     * not kept after this: a sheet reloaded later gets its own texture.
+     * *******************************/
+    Sprite *sprites[ASSETS_MAX]; SDL_Surface *sheets[ASSETS_MAX]; int ids[ASSETS_MAX];
+    int n = 0;
+    for( int id=0; id<am->n; id++ )
+    {
+        if(  (assets_state(am, id) != ASSET_READY) || (am->asset[id].surf == NULL)  ) continue;
+        sprites[n] = am->asset[id].sprite; sheets[n] = am->asset[id].surf; ids[n] = id; n++;
+    }
+    if(  n == 0  ) return -1;
+    SDL_Texture *old[ASSETS_MAX];
+    for( int i=0; i<n; i++ ) old[i] = sprites[i]->tex;
+    int ret = atlas_build(atlas, ren, sprites, sheets, n);
+    for( int i=0; i<n; i++ )
+    {
+        Asset *asset = &am->asset[ids[i]];
+        if(  ret == 0  ) SDL_DestroyTexture(old[i]);            // Sprites draw from the atlas now
+        else assets_apply(asset, old[i], false);                // Frame rects back in sheet coordinates
+        SDL_FreeSurface(asset->surf);
+        asset->surf = NULL;
+    }
+    am->keep_surfaces = false;
+    return ret;
+}
+
+void assets_free(AssetManager *am)
+{ // Stop the workers. Sprites keep their textures (see sprite_free).
+    SDL_AtomicSet(&am->quit, 1);
+    for( int i=0; i<am->nworkers; i++ ) SDL_SemPost(am->work);
+    for( int i=0; i<am->nworkers; i++ ) SDL_WaitThread(am->worker[i], NULL);
+    for( int id=0; id<am->n; id++ ) { SDL_FreeSurface(am->asset[id].surf); free(am->asset[id].staged.mask); }
+    if(  am->lock != NULL  ) SDL_DestroyMutex(am->lock);
+    if(  am->work != NULL  ) SDL_DestroySemaphore(am->work);
+    SDL_zero(*am);
+}
+
+#endif // __ASSETS_H__
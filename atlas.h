@@ -0,0 +1,372 @@
+#ifndef __ATLAS_H__
+#define __ATLAS_H__
+/* *************Texture atlas***************
+ * Pack the frames of every sprite sheet into one texture.
+ *
+ * - Each Sprite gets its own texture: switching animations switches
+ *   textures, and SDL cannot batch draws across a texture switch.
+ * - One atlas texture for all sprites: every sprite draw is from the
+ *   same texture, so SDL batches them.
+ *
+ * Only the frames are packed (sprite->framecnt frames). Empty cells
+ * are trimmed away. After atlas_build(), sprite->tex is the atlas
+ * texture and sprite->frame_rect[] holds atlas coordinates, so
+ * anim_load_frame() needs no changes.
+ *
+ * Example:
+ *      SDL_Surface *surf_PI = sprite_load_surface(PenguinIdle.path);
+ *      sprite_load_info(&PenguinIdle, surf_PI);
+ *      ...
+ *      Sprite *sprites[] = {&PenguinIdle, &PenguinWalk};
+ *      SDL_Surface *sheets[] = {surf_PI, surf_PW};
+ *      Atlas atlas;
+ *      if(  atlas_build(&atlas, ren, sprites, sheets, 2) < 0  ) ...
+ *      ...
+ *      atlas_free(&atlas);
+ *
+ * Packer: skyline, bottom-left rule. The skyline is the top edge of
+ * the packed rects. A new rect goes where its top edge ends up lowest.
+ *
+ * Identical frames (e.g., an idle hold drawn as the same frame 4
+ * times, in one sheet or across sheets) are packed once: each frame
+ * is hashed into a hash table (open addressing), and a frame with the
+ * same hash and the same pixels points its frame_rect at the first
+ * copy. frame_rect[] is then the
+ * map from logical frame number to physical region in the atlas.
+ * Only exact copies are merged (lossless).
+ * *******************************/
+#include <stdlib.h>
+#include <SDL.h>
+#include "sprite.h"
+
+#define ATLAS_MAX_NODES 512             // Max segments in the skyline
+#define ATLAS_PADDING 1                 // Transparent gap between frames (no bleeding)
+#define ATLAS_MAX_SIZE 4096             // Max atlas w or h if renderer does not say
+
+typedef struct
+{
+    int x, y, w;                        // Segment of the skyline: top edge is y from x to x+w
+} SkylineNode;
+
+typedef struct
+{
+    SDL_Texture *tex;                   // One texture for all packed frames
+    int w, h;                           // Size of tex
+    SkylineNode node[ATLAS_MAX_NODES];
+    int nnodes;
+} Atlas;
+
+void atlas_init(Atlas *atlas, int w, int h)
+{ // Empty atlas: skyline is one segment along the bottom
+    atlas->tex = NULL;
+    atlas->w = w; atlas->h = h;
+    atlas->node[0] = (SkylineNode){.x=0, .y=0, .w=w};
+    atlas->nnodes = 1;
+}
+
+int atlas_skyline_fit(const Atlas *atlas, int i, int w, int h)
+{ // Return y where a w x h rect sits if its left edge is at node i, or -1 if it does not fit
+    int x = atlas->node[i].x;
+    if(  x + w > atlas->w  ) return -1;
+    int y = atlas->node[i].y;
+    int width_left = w;
+    for( int j=i; width_left > 0; j++ )
+    { // Rect rests on the highest segment under it
+        if(  j >= atlas->nnodes  ) return -1;
+        if(  atlas->node[j].y > y  ) y = atlas->node[j].y;
+        if(  y + h > atlas->h  ) return -1;
+        width_left -= atlas->node[j].w;
+    }
+    return y;
+}
+
+bool atlas_pack(Atlas *atlas, int w, int h, SDL_Rect *rect)
+{ // Find room for a w x h rect. Return false if atlas is full.
+    int best = -1; int best_y = 0; int best_w = 0;
+    for( int i=0; i<atlas->nnodes; i++ )
+    { // Bottom-left rule: lowest top edge, then narrowest segment
+        int y = atlas_skyline_fit(atlas, i, w, h);
+        if(  y < 0  ) continue;
+        if(  (best < 0) || (y+h < best_y+h) || ((y+h == best_y+h) && (atlas->node[i].w < best_w))  )
+        {
+            best = i; best_y = y; best_w = atlas->node[i].w;
+        }
+    }
+    if(  (best < 0) || (atlas->nnodes >= ATLAS_MAX_NODES)  ) return false;
+    *rect = (SDL_Rect){.x=atlas->node[best].x, .y=best_y, .w=w, .h=h};
+
+    { // Insert the new segment on top of the rect
+        SkylineNode *n = atlas->node;
+        memmove(&n[best+1], &n[best], (atlas->nnodes-best)*sizeof(SkylineNode));
+        n[best] = (SkylineNode){.x=rect->x, .y=best_y+h, .w=w};
+        atlas->nnodes++;
+    }
+    for( int i=best+1; i<atlas->nnodes; i++ )
+    { // Shrink or remove the segments now under the new segment
+        SkylineNode *n = atlas->node;
+        int right = n[i-1].x + n[i-1].w;
+        if(  n[i].x >= right  ) break;
+        int shrink = right - n[i].x;
+        n[i].x += shrink; n[i].w -= shrink;
+        if(  n[i].w > 0  ) break;
+        memmove(&n[i], &n[i+1], (atlas->nnodes-i-1)*sizeof(SkylineNode));
+        atlas->nnodes--; i--;
+    }
+    for( int i=0; i+1<atlas->nnodes; i++ )
+    { // Merge neighbor segments at the same height
+        SkylineNode *n = atlas->node;
+        if(  n[i].y != n[i+1].y  ) continue;
+        n[i].w += n[i+1].w;
+        memmove(&n[i+1], &n[i+2], (atlas->nnodes-i-2)*sizeof(SkylineNode));
+        atlas->nnodes--; i--;
+    }
+    return true;
+}
+
+bool atlas_rect_inside(SDL_Surface *sheet, const SDL_Rect *r)
+{ // Return true if rect r is inside the sheet (sprite_apply_layout clips frame rects to the sheet)
+    return (r->x >= 0) && (r->y >= 0) && (r->w >= 0) && (r->h >= 0) &&
+           (r->x + r->w <= sheet->w) && (r->y + r->h <= sheet->h);
+}
+
+uint32_t atlas_frame_hash(SDL_Surface *sheet, const SDL_Rect *r)
+{ // FNV-1a hash of the pixels in rect r of a 32-bit sheet (only its size if r is not inside the sheet)
+    uint32_t h = 2166136261u ^ (uint32_t)r->w ^ ((uint32_t)r->h << 16);
+    if(  atlas_rect_inside(sheet, r) == false  ) return h;
+    for( int y=r->y; y<r->y+r->h; y++ )
+    {
+        const uint8_t *p = (const uint8_t *)sheet->pixels + y*sheet->pitch + 4*r->x;
+        for( int i=0; i<4*r->w; i++ ) { h ^= p[i]; h *= 16777619u; }
+    }
+    return h;
+}
+
+bool atlas_frames_equal(SDL_Surface *sheet_a, const SDL_Rect *a, SDL_Surface *sheet_b, const SDL_Rect *b)
+{ // Return true if the two frames have the same size and pixels (false if either is not inside its sheet)
+    if(  (a->w != b->w) || (a->h != b->h)  ) return false;
+    if(  (atlas_rect_inside(sheet_a, a) == false) || (atlas_rect_inside(sheet_b, b) == false)  ) return false;
+    for( int y=0; y<a->h; y++ )
+    {
+        const uint8_t *pa = (const uint8_t *)sheet_a->pixels + (a->y+y)*sheet_a->pitch + 4*a->x;
+        const uint8_t *pb = (const uint8_t *)sheet_b->pixels + (b->y+y)*sheet_b->pitch + 4*b->x;
+        if(  memcmp(pa, pb, 4*a->w) != 0  ) return false;
+    }
+    return true;
+}
+
+typedef struct
+{ // A frame that is the first copy of its pixels, in the atlas_find_duplicates hash table
+    uint32_t hash;
+    int k;                              // Frame number, -1 : empty slot
+    int sheet;
+    const SDL_Rect *rect;
+} AtlasSlot;
+
+int atlas_find_duplicates(Sprite **sprites, SDL_Surface **sheets, int n, int *dup)
+{ // dup[k] : index of the first frame with the same pixels as frame k, or -1. Return the number of duplicates, -1 if out of memory.
+    /* *************DOC***************
+     * Frames are numbered like rects[] in atlas_pack_sprites.
+     * Sheets must be 32-bit (see sprite_load_surface).
+     * First copies go in a hash table (open addressing, at least 2
+     * slots per frame), so each frame is one hash and a probe or two,
+     * and pixels are only compared when the hashes match.
+     * *******************************/
+    int nframes = 0;
+    for( int s=0; s<n; s++ ) nframes += sprites[s]->framecnt;
+    int bits = 1;
+    while(  (1 << bits) < 2*nframes  ) bits++;
+    int nslots = 1 << bits;
+    AtlasSlot *slot = malloc(nslots*sizeof(AtlasSlot));
+    if(  slot == NULL  )
+    {
+        puts("Out of memory finding duplicate frames");
+        return -1;
+    }
+    for( int i=0; i<nslots; i++ ) slot[i].k = -1;
+    int ndup = 0;
+    for( int s=0, k=0; s<n; s++ )
+    {
+        for( int f=0; f<sprites[s]->framecnt; f++, k++ )
+        {
+            const SDL_Rect *rect = &sprites[s]->frame_rect[f];
+            uint32_t hash = atlas_frame_hash(sheets[s], rect);
+            int i = (int)((hash*2654435761u) >> (32 - bits));  // Top bits : 0 to nslots-1
+            dup[k] = -1;
+            for( ; slot[i].k >= 0; i = (i+1) & (nslots-1) )
+            { // Compare pixels only if the hash matches
+                if(  slot[i].hash != hash  ) continue;
+                if(  atlas_frames_equal(sheets[slot[i].sheet], slot[i].rect, sheets[s], rect) == false  ) continue;
+                dup[k] = slot[i].k; ndup++;
+                break;
+            }
+            if(  dup[k] < 0  ) slot[i] = (AtlasSlot){.hash=hash, .k=k, .sheet=s, .rect=rect}; // First copy
+        }
+    }
+    free(slot);
+    return ndup;
+}
+
+bool atlas_pack_sprites(Atlas *atlas, Sprite **sprites, int n, SDL_Rect *rects, const int *dup)
+{ // Pack every frame of every sprite. rects gets one rect per frame, in order.
+    /* *************DOC***************
+     * Sprites are packed biggest frame size first (better fit).
+     * rects[] is ordered like sprites[]: frames of sprites[0], then
+     * frames of sprites[1], ...
+     * Each rect includes ATLAS_PADDING on its right and bottom.
+     * A duplicate frame (dup[k] >= 0, see atlas_find_duplicates) is
+     * not packed: it gets the rect of frame dup[k].
+     * *******************************/
+    int first[n];                                               // Index of sprite's first rect
+    bool done[n];
+    for( int s=0, k=0; s<n; s++ ) { first[s] = k; k += sprites[s]->framecnt; done[s] = false; }
+    for( int packed=0; packed<n; packed++ )
+    {
+        int s = -1;
+        for( int t=0; t<n; t++ )
+        { // Pick the biggest sprite not packed yet
+            if(  done[t]  ) continue;
+            if(  (s < 0) || (sprites[t]->size > sprites[s]->size)  ) s = t;
+        }
+        done[s] = true;
+        for( int f=0; f<sprites[s]->framecnt; f++ )
+        {
+            const SDL_Rect *src = &sprites[s]->frame_rect[f];
+            if(  dup[first[s]+f] >= 0  ) continue;
+            if(  atlas_pack(atlas, src->w + ATLAS_PADDING, src->h + ATLAS_PADDING,
+                            &rects[first[s]+f]) == false  ) return false;
+        }
+    }
+    for( int s=0; s<n; s++ )
+    { // Duplicates share the first copy's rect (dup[k] < k, so that copy is packed)
+        for( int f=0, k=first[s]; f<sprites[s]->framecnt; f++, k++ ) if( dup[k] >= 0 ) rects[k] = rects[dup[k]];
+    }
+    return true;
+}
+
+SDL_Surface *atlas_compose(Atlas *atlas, Sprite **sprites, SDL_Surface **sheets, int n, int max_size)
+{ // Pack the frames of n sprite sheets and copy them into one Surface. Return NULL if they do not fit.
+    /* *************DOC***************
+     * sheets[i] is the decoded sheet for sprites[i] (see sprite_load_surface).
+     * Sheets are only read. The caller frees them and the returned Surface.
+     * On success, sprites[i]->frame_rect[] is in atlas coordinates.
+     * On error, the sprites are not changed.
+     * *******************************/
+    int nframes = 0; int area = 0;
+    for( int s=0; s<n; s++ ) nframes += sprites[s]->framecnt;
+    if(  nframes == 0  ) return NULL;
+    int *dup = malloc(nframes*sizeof(int));                     // Heap : a big bake has too many frames for the stack
+    SDL_Rect *rects = malloc(nframes*sizeof(SDL_Rect));
+    int ndup = ((dup != NULL) && (rects != NULL)) ? atlas_find_duplicates(sprites, sheets, n, dup) : -1;
+    if(  ndup < 0  )
+    {
+        if(  (dup == NULL) || (rects == NULL)  ) puts("Out of memory packing the atlas");
+        free(dup); free(rects);
+        return NULL;
+    }
+    for( int s=0, k=0; s<n; s++ )
+    {
+        for( int f=0; f<sprites[s]->framecnt; f++, k++ )
+        { // Frames need not be square or the same size (see layout.h)
+            const SDL_Rect *r = &sprites[s]->frame_rect[f];
+            if(  dup[k] < 0  ) area += (r->w + ATLAS_PADDING)*(r->h + ATLAS_PADDING);
+        }
+    }
+    int size = 64;
+    while(  size*size < area  ) size *= 2;                      // Smallest square that could fit
+    bool fits = false;
+    for( ; size <= max_size; size *= 2 )
+    { // Grow the atlas until everything fits
+        atlas_init(atlas, size, size);
+        if(  (fits = atlas_pack_sprites(atlas, sprites, n, rects, dup))  ) break;
+    }
+    if(  fits == false  )
+    {
+        printf("Sprite sheets do not fit in a %dx%d atlas\n", max_size, max_size);
+        free(dup); free(rects);
+        return NULL;
+    }
+
+    SDL_Surface *surf = SDL_CreateRGBSurfaceWithFormat(0, atlas->w, atlas->h, 32, SDL_PIXELFORMAT_ARGB8888);
+    if(  surf == NULL  )
+    {
+        printf("Cannot create atlas surface: %s\n", SDL_GetError());
+        free(dup); free(rects);
+        return NULL;
+    }
+    for( int s=0, k=0; s<n; s++ )
+    { // Copy each frame (with its alpha) into its rect
+        SDL_SetSurfaceBlendMode(sheets[s], SDL_BLENDMODE_NONE);
+        for( int f=0; f<sprites[s]->framecnt; f++, k++ )
+        {
+            if(  dup[k] >= 0  ) continue;                       // Already copied
+            SDL_Rect dst = rects[k];
+            SDL_BlitSurface(sheets[s], &sprites[s]->frame_rect[f], surf, &dst);
+        }
+    }
+    for( int s=0, k=0; s<n; s++ )
+    { // Frame rects are now in atlas coordinates
+        for( int f=0; f<sprites[s]->framecnt; f++, k++ )
+        {
+            sprites[s]->frame_rect[f].x = rects[k].x;
+            sprites[s]->frame_rect[f].y = rects[k].y;
+        }
+        if(  sprites[s]->framecnt > 0  )
+        {
+            sprites[s]->frame = sprites[s]->frame_rect[sprites[s]->framenum-1];
+        }
+    }
+    printf("Packed %d frames (%d duplicates shared) from %d sprite sheets into a %dx%d atlas\n",
+           nframes, ndup, n, atlas->w, atlas->h);
+    free(dup); free(rects);
+    return surf;
+}
+
+int atlas_max_size(SDL_Renderer *ren)
+{ // Biggest atlas the renderer can hold
+    int max_size = ATLAS_MAX_SIZE;
+    SDL_RendererInfo info;
+    if(  (ren != NULL) && (SDL_GetRendererInfo(ren, &info) == 0) && (info.max_texture_width > 0)  )
+    {
+        max_size = (info.max_texture_width < info.max_texture_height) ?
+                    info.max_texture_width : info.max_texture_height;
+    }
+    return max_size;
+}
+
+void atlas_attach(Atlas *atlas, Sprite **sprites, int n)
+{ // Point the sprites at the atlas texture
+    for( int s=0; s<n; s++ )
+    {
+        sprites[s]->tex = atlas->tex;
+        sprites[s]->shared_tex = true;
+    }
+}
+
+int atlas_build(Atlas *atlas, SDL_Renderer *ren, Sprite **sprites, SDL_Surface **sheets, int n)
+{ // Pack the frames of n sprite sheets into one texture. Return -1 if they do not fit.
+    /* *************DOC***************
+     * sheets[i] is the decoded sheet for sprites[i] (see sprite_load_surface).
+     * Sheets are only read. The caller frees them.
+     * On error, sprites do not point at the atlas.
+     * *******************************/
+    SDL_Surface *surf = atlas_compose(atlas, sprites, sheets, n, atlas_max_size(ren));
+    if(  surf == NULL  ) return -1;
+    atlas->tex = SDL_CreateTextureFromSurface(ren, surf);
+    SDL_FreeSurface(surf);
+    if(  atlas->tex == NULL  )
+    {
+        printf("Cannot create atlas texture: %s\n", SDL_GetError());
+        return -1;
+    }
+    SDL_SetTextureBlendMode(atlas->tex, SDL_BLENDMODE_BLEND);
+    atlas_attach(atlas, sprites, n);
+    return 0;
+}
+
+void atlas_free(Atlas *atlas)
+{
+    SDL_DestroyTexture(atlas->tex);
+    atlas->tex = NULL;
+}
+
+#endif // __ATLAS_H__
@@ -0,0 +1,119 @@
+/* *************DOC***************
+ * Bake every sprite sheet in a folder into one atlas file.
+ * See bake.h for the file layout.
+ *
+ * Example
+ * -------
+ * ./bake-atlas.exe art art.atlas
+ *
+ * Arguments
+ * ---------
+ * 1 : folder of .png sprite sheets (default: art)
+ * 2 : baked atlas file to write (default: art.atlas)
+ * 3 : "argb" to always write ARGB8888 pixels (default: palette
+ *     indices if the atlas has at most 256 colors, see bake.h)
+ *
+ * Sheet names in the atlas are "folder/file.png", the same path
+ * main.c uses to load the sheet.
+ *
+ * Sheets that fail to load (e.g., no transparent background) are
+ * skipped with a message.
+ * *******************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <dirent.h>
+#include <SDL.h>
+#include <SDL_image.h>
+#include "sprite.h"
+#include "atlas.h"
+#include "bake.h"
+
+#define BAKE_MAX_SHEETS 256
+
+int compare_names(const void *a, const void *b)
+{ // Sort sheet paths so the baked file is the same every time
+    return strcmp((const char *)a, (const char *)b);
+}
+
+bool is_png(const char *name)
+{
+    size_t len = strlen(name);
+    return (len > 4) && (strcmp(name + len - 4, ".png") == 0);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *art_dir = (argc>1) ? argv[1] : "art";
+    const char *out_path = (argc>2) ? argv[2] : "art.atlas";
+    bool use_palette = (argc>3) ? (strcmp(argv[3], "argb") != 0) : true;
+
+    static char paths[BAKE_MAX_SHEETS][BAKE_NAME_LEN];
+    int npaths = 0;
+    { // List the .png files
+        DIR *dir = opendir(art_dir);
+        if(  dir == NULL  )
+        {
+            printf("Cannot open folder \"%s\"\n", art_dir);
+            return EXIT_FAILURE;
+        }
+        struct dirent *entry;
+        while(  (entry = readdir(dir)) != NULL  )
+        {
+            if(  is_png(entry->d_name) == false  ) continue;
+            if(  npaths == BAKE_MAX_SHEETS  )
+            {
+                printf("More than %d sprite sheets. Skipping the rest.\n", BAKE_MAX_SHEETS);
+                break;
+            }
+            int len = snprintf(paths[npaths], BAKE_NAME_LEN, "%s/%s", art_dir, entry->d_name);
+            if(  len >= BAKE_NAME_LEN  )
+            {
+                printf("Skipping \"%s/%s\": path is longer than %d characters\n",
+                       art_dir, entry->d_name, BAKE_NAME_LEN-1);
+                continue;
+            }
+            npaths++;
+        }
+        closedir(dir);
+        qsort(paths, npaths, BAKE_NAME_LEN, compare_names);
+    }
+
+    IMG_Init(IMG_INIT_PNG);
+    Sprite *sprite_mem = calloc(npaths, sizeof(Sprite));       // Sprite is big: keep off the stack
+    if(  (sprite_mem == NULL) && (npaths > 0)  ) { puts("Out of memory"); IMG_Quit(); SDL_Quit(); return EXIT_FAILURE; }
+    Sprite *sprites[BAKE_MAX_SHEETS];
+    SDL_Surface *sheets[BAKE_MAX_SHEETS];
+    int n = 0;
+    for( int i=0; i<npaths; i++ )
+    { // Decode and analyze each sheet
+        SDL_Surface *surf = sprite_load_surface(paths[i]);
+        if(  surf == NULL  ) { printf("Skipping \"%s\"\n", paths[i]); continue; }
+        sprites[n] = &sprite_mem[n];
+        sprites[n]->path = paths[i];
+        sprite_load_info(sprites[n], surf);
+        sheets[n] = surf;
+        printf("%s: %d frames of %dx%d\n", paths[i], sprites[n]->framecnt, sprites[n]->frame_w, sprites[n]->frame_h);
+        n++;
+    }
+
+    int ret = EXIT_FAILURE;
+    Atlas *atlas = malloc(sizeof(Atlas));
+    if(  atlas == NULL  ) puts("Out of memory");
+    SDL_Surface *atlas_surf = ((n > 0) && (atlas != NULL)) ? atlas_compose(atlas, sprites, sheets, n, ATLAS_MAX_SIZE) : NULL;
+    if(  (atlas_surf != NULL) && (bake_write(out_path, atlas_surf, sprites, n, use_palette) == 0)  )
+    {
+        printf("Baked %d sprite sheets into \"%s\" (%dx%d)\n", n, out_path, atlas_surf->w, atlas_surf->h);
+        ret = EXIT_SUCCESS;
+    }
+
+    // Shutdown
+    SDL_FreeSurface(atlas_surf);
+    for( int i=0; i<n; i++ ) { SDL_FreeSurface(sheets[i]); free(sprites[i]->mask); }
+    free(atlas);
+    free(sprite_mem);
+    IMG_Quit();
+    SDL_Quit();
+    return ret;
+}
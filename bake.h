@@ -0,0 +1,412 @@
+#ifndef __BAKE_H__
+#define __BAKE_H__
+/* *************Baked atlas***************
+ * The atlas, already packed, saved to one file.
+ *
+ * At startup, loading PNGs means: decode every PNG, scan every
+ * pixel for frames, pack, then upload. A baked atlas skips all of
+ * that: map the file and upload the pixels as-is.
+ *
+ * Bake the art folder:
+ *      make bake
+ * (same as: ./bake-atlas.exe art art.atlas)
+ *
+ * Load it:
+ *      Atlas atlas;
+ *      if(  bake_load(&atlas, ren, "art.atlas", sprites, NSPRITES) < 0  )
+ *      { // No baked atlas (or it is stale): load the PNGs
+ *          ...
+ *      }
+ *
+ * The baked atlas is stale if any PNG is newer than the baked file.
+ *
+ * File layout (native byte order, every section 16-byte aligned):
+ *      BakeHeader
+ *      BakeSheet[nsheets]      : one per sprite sheet, looked up by path
+ *      BakeFrame[nframes]      : frame rects in the atlas
+ *      palette                 : BAKE_INDEX8 only, 256 ARGB8888 colors
+ *      pixels                  : h rows of pitch bytes, ARGB8888 or palette indices
+ *
+ * Pixel-art atlases rarely have more than 256 colors. Then the pixels
+ * are written as one byte per pixel (BAKE_INDEX8), a quarter of the
+ * file, and expanded back to ARGB8888 at load. Exact colors only: if
+ * the atlas has more than 256 colors, it is written as ARGB8888.
+ * Identical frames are already stored once (see atlas.h).
+ *
+ * The frames' alpha masks (see collide.h) are not in the file: they
+ * are built from the atlas pixels at load.
+ * *******************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include <SDL.h>
+#include "sprite.h"
+#include "atlas.h"
+
+#define BAKE_MAGIC "SPAT"
+#define BAKE_VERSION 4
+#define BAKE_NAME_LEN 64                // Max path length of a sprite sheet, including nul
+#define BAKE_ARGB8888 0                 // Pixel format : 4 bytes per pixel
+#define BAKE_INDEX8 1                   // Pixel format : 1 byte per pixel, index into the palette
+#define BAKE_PALETTE_LEN 256
+
+typedef struct
+{
+    char magic[4];                      // BAKE_MAGIC
+    uint32_t version;                   // BAKE_VERSION
+    uint32_t w, h;                      // Atlas size
+    uint32_t pitch;                     // Bytes per row of pixels
+    uint32_t nsheets;
+    uint32_t nframes;
+    uint32_t format;                    // BAKE_ARGB8888 or BAKE_INDEX8
+    uint32_t palette_offset;            // Byte offset of palette from start of file (BAKE_INDEX8)
+    uint32_t pixels_offset;             // Byte offset of pixels from start of file
+} BakeHeader;
+
+typedef struct
+{
+    char name[BAKE_NAME_LEN];           // Sprite sheet path, e.g., "art/penguin-huff.png"
+    int32_t size;                       // See Sprite
+    int32_t frame_w, frame_h;
+    int32_t framecnt;
+    int32_t first_frame;                // Index of frame 1 in BakeFrame table
+    int32_t sheet_w, sheet_h;
+    int32_t cols, rows;
+    int32_t has_durations;              // 1 : BakeFrame ms is set
+    uint32_t occupied[SPRITE_MAX_CELLS/32];
+} BakeSheet;
+
+typedef struct
+{
+    int32_t x, y, w, h;                 // Frame rect in the atlas
+    int32_t ox, oy;                     // See Sprite frame_offset
+    int32_t ms;                         // See Sprite frame_ms
+} BakeFrame;
+
+typedef struct
+{
+    uint8_t *data;                      // Whole file, read-only
+    size_t len;
+} BakeMap;
+
+int bake_map(BakeMap *map, const char *path)
+{ // Map the file at path into memory (read-only). Return -1 on error.
+    map->data = NULL; map->len = 0;
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, NULL);
+    if(  file == INVALID_HANDLE_VALUE  ) return -1;
+    LARGE_INTEGER len;
+    if(  (GetFileSizeEx(file, &len) == 0) || (len.QuadPart == 0)  ) { CloseHandle(file); return -1; }
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);                                          // Mapping keeps the file open
+    if(  mapping == NULL  ) return -1;
+    map->data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);                                       // View keeps the mapping open
+    if(  map->data == NULL  ) return -1;
+    map->len = (size_t)len.QuadPart;
+#else
+    int fd = open(path, O_RDONLY);
+    if(  fd < 0  ) return -1;
+    struct stat st;
+    if(  (fstat(fd, &st) < 0) || (st.st_size == 0)  ) { close(fd); return -1; }
+    void *p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);                                                  // Mapping keeps the file open
+    if(  p == MAP_FAILED  ) return -1;
+    map->data = p;
+    map->len = (size_t)st.st_size;
+#endif
+    return 0;
+}
+
+void bake_unmap(BakeMap *map)
+{
+    if(  map->data == NULL  ) return;
+#ifdef _WIN32
+    UnmapViewOfFile(map->data);
+#else
+    munmap(map->data, map->len);
+#endif
+    map->data = NULL; map->len = 0;
+}
+
+size_t bake_align(size_t offset)
+{ // Round offset up to a multiple of 16
+    return (offset + 15) & ~(size_t)15;
+}
+
+int bake_palette(SDL_Surface *surf, uint32_t *palette, uint8_t *index)
+{ // Find the colors of a 32-bit surface. Return the color count, or -1 if more than BAKE_PALETTE_LEN.
+    /* *************DOC***************
+     * palette : room for BAKE_PALETTE_LEN colors
+     * index   : room for w*h bytes, gets the palette index of each pixel
+     * Colors go in a small hash table (open addressing, 4 slots per
+     * palette entry) so each pixel is one multiply and a probe or two.
+     * *******************************/
+    #define BAKE_SLOTS (4*BAKE_PALETTE_LEN)
+    uint32_t key[BAKE_SLOTS]; int16_t slot_color[BAKE_SLOTS];
+    for( int i=0; i<BAKE_SLOTS; i++ ) slot_color[i] = -1;
+    int ncolors = 0;
+    for( int y=0; y<surf->h; y++ )
+    {
+        const uint32_t *row = (const uint32_t *)((const uint8_t *)surf->pixels + y*surf->pitch);
+        for( int x=0; x<surf->w; x++ )
+        {
+            uint32_t c = row[x];
+            int slot = (int)((c*2654435761u) >> 22);            // Top 10 bits : 0 to BAKE_SLOTS-1
+            while(  (slot_color[slot] >= 0) && (key[slot] != c)  ) slot = (slot+1) % BAKE_SLOTS;
+            if(  slot_color[slot] < 0  )
+            { // New color
+                if(  ncolors == BAKE_PALETTE_LEN  ) return -1;
+                key[slot] = c; slot_color[slot] = (int16_t)ncolors;
+                palette[ncolors++] = c;
+            }
+            index[y*surf->w + x] = (uint8_t)slot_color[slot];
+        }
+    }
+    #undef BAKE_SLOTS
+    return ncolors;
+}
+
+int bake_write(const char *path, SDL_Surface *atlas_surf, Sprite **sprites, int n, bool use_palette)
+{ // Write a baked atlas file. atlas_surf and sprites come from atlas_compose(). Return -1 on error.
+    /* *************DOC***************
+     * use_palette : write BAKE_INDEX8 if the atlas has at most
+     *               BAKE_PALETTE_LEN colors (else ARGB8888)
+     * *******************************/
+    BakeHeader hdr = {.version=BAKE_VERSION, .w=atlas_surf->w, .h=atlas_surf->h,
+                      .pitch=4*atlas_surf->w, .nsheets=n, .nframes=0, .format=BAKE_ARGB8888};
+    memcpy(hdr.magic, BAKE_MAGIC, 4);
+    for( int s=0; s<n; s++ ) hdr.nframes += sprites[s]->framecnt;
+    size_t sheets_offset = bake_align(sizeof(BakeHeader));
+    size_t frames_offset = bake_align(sheets_offset + n*sizeof(BakeSheet));
+    size_t frames_end = frames_offset + hdr.nframes*sizeof(BakeFrame);
+    hdr.pixels_offset = bake_align(frames_end);
+
+    uint32_t palette[BAKE_PALETTE_LEN] = {0};
+    uint8_t *index = use_palette ? malloc((size_t)atlas_surf->w*atlas_surf->h) : NULL;
+    if(  index != NULL  )
+    {
+        int ncolors = bake_palette(atlas_surf, palette, index);
+        if(  ncolors >= 0  )
+        {
+            printf("Atlas has %d colors: writing palette indices\n", ncolors);
+            hdr.format = BAKE_INDEX8;
+            hdr.pitch = atlas_surf->w;
+            hdr.palette_offset = bake_align(frames_end);
+            hdr.pixels_offset = bake_align(hdr.palette_offset + sizeof(palette));
+        }
+        else
+        {
+            printf("Atlas has more than %d colors: writing ARGB8888\n", BAKE_PALETTE_LEN);
+            free(index); index = NULL;
+        }
+    }
+
+    FILE *f = fopen(path, "wb");
+    if(  f == NULL  )
+    {
+        printf("Cannot open \"%s\" for writing\n", path);
+        free(index);
+        return -1;
+    }
+    static const uint8_t zeros[16] = {0};
+    fwrite(&hdr, sizeof(hdr), 1, f);
+    fwrite(zeros, 1, sheets_offset - sizeof(hdr), f);
+    int first_frame = 0;
+    for( int s=0; s<n; s++ )
+    { // Sheet table
+        BakeSheet sheet = {.size=sprites[s]->size, .framecnt=sprites[s]->framecnt,
+                           .frame_w=sprites[s]->frame_w, .frame_h=sprites[s]->frame_h,
+                           .has_durations=sprites[s]->has_durations,
+                           .first_frame=first_frame,
+                           .sheet_w=sprites[s]->sheet_w, .sheet_h=sprites[s]->sheet_h,
+                           .cols=sprites[s]->cols, .rows=sprites[s]->rows};
+        snprintf(sheet.name, BAKE_NAME_LEN, "%s", sprites[s]->path);
+        memcpy(sheet.occupied, sprites[s]->occupied, sizeof(sheet.occupied));
+        fwrite(&sheet, sizeof(sheet), 1, f);
+        first_frame += sprites[s]->framecnt;
+    }
+    fwrite(zeros, 1, frames_offset - (sheets_offset + n*sizeof(BakeSheet)), f);
+    for( int s=0; s<n; s++ )
+    { // Frame table
+        for( int i=0; i<sprites[s]->framecnt; i++ )
+        {
+            const SDL_Rect *r = &sprites[s]->frame_rect[i];
+            BakeFrame frame = {.x=r->x, .y=r->y, .w=r->w, .h=r->h, .ms=sprites[s]->frame_ms[i],
+                               .ox=sprites[s]->frame_offset[i].x, .oy=sprites[s]->frame_offset[i].y};
+            fwrite(&frame, sizeof(frame), 1, f);
+        }
+    }
+    if(  hdr.format == BAKE_INDEX8  )
+    { // Palette, then one index per pixel
+        fwrite(zeros, 1, hdr.palette_offset - frames_end, f);
+        fwrite(palette, sizeof(palette), 1, f);
+        fwrite(zeros, 1, hdr.pixels_offset - (hdr.palette_offset + sizeof(palette)), f);
+        fwrite(index, 1, (size_t)hdr.pitch*hdr.h, f);
+        free(index);
+    }
+    else
+    {
+        fwrite(zeros, 1, hdr.pixels_offset - frames_end, f);
+        for( int r=0; r<atlas_surf->h; r++ )
+        { // Pixels, without the surface row padding
+            fwrite((uint8_t *)atlas_surf->pixels + r*atlas_surf->pitch, 1, hdr.pitch, f);
+        }
+    }
+    bool ok = (ferror(f) == 0);
+    if(  fclose(f) != 0  ) ok = false;
+    if(  ok == false  )
+    {
+        printf("Failed writing \"%s\"\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+bool bake_is_stale(const char *bake_path, Sprite **sprites, int n)
+{ // Return true if any sprite sheet (or its layout descriptor) is newer than the baked file
+    struct stat bake_st, png_st;
+    if(  stat(bake_path, &bake_st) < 0  ) return true;
+    for( int s=0; s<n; s++ )
+    {
+        if(  (stat(sprites[s]->path, &png_st) == 0) && (png_st.st_mtime > bake_st.st_mtime)  ) return true;
+        char path[256];
+        for( int e=0; e<LAYOUT_NEXT; e++ )
+        {
+            layout_path(path, sizeof(path), sprites[s]->path, layout_ext[e]);
+            if(  (stat(path, &png_st) == 0) && (png_st.st_mtime > bake_st.st_mtime)  ) return true;
+        }
+    }
+    return false;
+}
+
+int bake_load_mapped(Atlas *atlas, SDL_Renderer *ren, const BakeMap *map, const char *path,
+                     Sprite **sprites, int n)
+{ // Load sprites from a mapped baked atlas. See bake_load().
+    const BakeHeader *hdr = (const BakeHeader *)map->data;
+    { // Check the file is a baked atlas and is not truncated
+        if(  map->len < sizeof(BakeHeader)  ) return -1;
+        if(  (memcmp(hdr->magic, BAKE_MAGIC, 4) != 0) || (hdr->version != BAKE_VERSION)  ) return -1;
+        size_t frames_end = bake_align(bake_align(sizeof(BakeHeader)) + hdr->nsheets*sizeof(BakeSheet))
+                            + hdr->nframes*sizeof(BakeFrame);
+        if(  frames_end > hdr->pixels_offset  ) return -1;
+        if(  (hdr->format != BAKE_ARGB8888) && (hdr->format != BAKE_INDEX8)  ) return -1;
+        if(  hdr->pitch < ((hdr->format == BAKE_INDEX8) ? 1 : 4)*hdr->w  ) return -1;
+        if(  (hdr->format == BAKE_INDEX8) &&
+             ((hdr->palette_offset < frames_end) ||
+              ((size_t)hdr->palette_offset + BAKE_PALETTE_LEN*sizeof(uint32_t) > hdr->pixels_offset))  ) return -1;
+        if(  (size_t)hdr->pixels_offset + (size_t)hdr->pitch*hdr->h > map->len  ) return -1;
+    }
+    const BakeSheet *sheets = (const BakeSheet *)(map->data + bake_align(sizeof(BakeHeader)));
+    const BakeFrame *frames = (const BakeFrame *)(map->data +
+                              bake_align(bake_align(sizeof(BakeHeader)) + hdr->nsheets*sizeof(BakeSheet)));
+    const BakeSheet *found[n];
+    for( int s=0; s<n; s++ )
+    { // Find each sprite sheet by path
+        found[s] = NULL;
+        for( uint32_t i=0; i<hdr->nsheets; i++ )
+        {
+            if(  strncmp(sheets[i].name, sprites[s]->path, BAKE_NAME_LEN) == 0  ) found[s] = &sheets[i];
+        }
+        if(  found[s] == NULL  )
+        {
+            printf("\"%s\" is not in \"%s\". Run: make bake\n", sprites[s]->path, path);
+            return -1;
+        }
+        const BakeSheet *b = found[s];
+        if(  (b->framecnt < 0) || (b->framecnt > SPRITE_MAX_FRAMES) || (b->first_frame < 0) ||
+             ((uint32_t)b->framecnt > hdr->nframes) ||
+             ((uint32_t)b->first_frame > hdr->nframes - (uint32_t)b->framecnt)  ) return -1;
+        if(  (b->framecnt > 0) && ((b->frame_w <= 0) || (b->frame_h <= 0))  ) return -1;
+        for( int i=0; i<b->framecnt; i++ )
+        { // Frame rects must be inside the atlas
+            const BakeFrame *fr = &frames[b->first_frame + i];
+            if(  (fr->x < 0) || (fr->y < 0) || (fr->w < 0) || (fr->h < 0) ||
+                 ((int64_t)fr->x + fr->w > hdr->w) || ((int64_t)fr->y + fr->h > hdr->h)  ) return -1;
+        }
+    }
+    atlas_init(atlas, hdr->w, hdr->h);
+    atlas->tex = SDL_CreateTexture(ren, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, hdr->w, hdr->h);
+    if(  atlas->tex == NULL  )
+    {
+        printf("Cannot create atlas texture: %s\n", SDL_GetError());
+        return -1;
+    }
+    const void *pixels = map->data + hdr->pixels_offset;         // ARGB8888 : upload straight from the file
+    int pitch = (int)hdr->pitch;
+    uint32_t *argb = NULL;
+    if(  hdr->format == BAKE_INDEX8  )
+    { // Expand the palette indices, then upload
+        const uint32_t *palette = (const uint32_t *)(map->data + hdr->palette_offset);
+        argb = malloc((size_t)hdr->w*hdr->h*sizeof(uint32_t));
+        if(  argb == NULL  )
+        {
+            printf("Out of memory expanding \"%s\"\n", path);
+            atlas_free(atlas);
+            return -1;
+        }
+        for( uint32_t y=0; y<hdr->h; y++ )
+        {
+            const uint8_t *index = map->data + hdr->pixels_offset + (size_t)y*hdr->pitch;
+            uint32_t *row = argb + (size_t)y*hdr->w;
+            for( uint32_t x=0; x<hdr->w; x++ ) row[x] = palette[index[x]];
+        }
+        pixels = argb; pitch = 4*hdr->w;
+    }
+    if(  SDL_UpdateTexture(atlas->tex, NULL, pixels, pitch) < 0  )
+    {
+        printf("Cannot upload atlas texture: %s\n", SDL_GetError());
+        free(argb);
+        atlas_free(atlas);
+        return -1;
+    }
+    SDL_SetTextureBlendMode(atlas->tex, SDL_BLENDMODE_BLEND);
+    for( int s=0; s<n; s++ )
+    { // Load sprite info from the sheet table instead of scanning pixels
+        const BakeSheet *b = found[s];
+        Sprite *sprite = sprites[s];
+        sprite->size = b->size; sprite->framecnt = b->framecnt;
+        sprite->frame_w = b->frame_w; sprite->frame_h = b->frame_h;
+        sprite->has_durations = (b->has_durations != 0);
+        sprite->sheet_w = b->sheet_w; sprite->sheet_h = b->sheet_h;
+        sprite->cols = b->cols; sprite->rows = b->rows;
+        memcpy(sprite->occupied, b->occupied, sizeof(sprite->occupied));
+        for( int i=0; i<b->framecnt; i++ )
+        {
+            const BakeFrame *fr = &frames[b->first_frame + i];
+            sprite->frame_rect[i] = (SDL_Rect){.x=fr->x, .y=fr->y, .w=fr->w, .h=fr->h};
+            sprite->frame_ms[i] = fr->ms;
+            sprite->frame_offset[i] = (SDL_Point){.x=fr->ox, .y=fr->oy};
+        }
+        sprite_build_masks(sprite, pixels, pitch, hdr->w, hdr->h, 0xFF000000); // Frames are trimmed already
+        sprite_init_state(sprite);
+    }
+    free(argb);
+    atlas_attach(atlas, sprites, n);
+    printf("Loaded %d sprite sheets from baked atlas \"%s\"\n", n, path);
+    return 0;
+}
+
+int bake_load(Atlas *atlas, SDL_Renderer *ren, const char *path, Sprite **sprites, int n)
+{ // Load sprites from a baked atlas. Return -1 if the file is missing, stale, or lacks a sprite.
+    /* *************DOC***************
+     * On error, the sprites are not changed.
+     * *******************************/
+    if(  bake_is_stale(path, sprites, n)  ) return -1;
+    BakeMap map;
+    if(  bake_map(&map, path) < 0  ) return -1;
+    int ret = bake_load_mapped(atlas, ren, &map, path, sprites, n);
+    bake_unmap(&map);
+    return ret;
+}
+
+#endif // __BAKE_H__
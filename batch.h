@@ -0,0 +1,142 @@
+#ifndef __BATCH_H__
+#define __BATCH_H__
+/* *************Sprite batch***************
+ * Draw many sprites with one SDL_RenderGeometry call per texture.
+ *
+ * SDL_RenderCopyEx is one draw per sprite. A batch collects quads
+ * (two triangles per sprite) and draws all quads that use the same
+ * texture in one call. Flips are done by swapping texture
+ * coordinates, not with RenderCopyEx.
+ *
+ * Example:
+ *      SpriteBatch batch; batch_init(&batch);
+ *      ...
+ *      batch_begin(&batch, ren);                       // Every frame
+ *      batch_push(&batch, sprite->tex, &sprite->frame, &sprite->render, flip);
+ *      ...                                             // Push many sprites
+ *      batch_flush(&batch);                            // Draw them
+ *      ...
+ *      batch_free(&batch);
+ *
+ * Draw order: sprites are drawn in push order within a texture, but
+ * all sprites of the first texture are drawn before the sprites of
+ * the second texture. Flush between layers that must not interleave.
+ * *******************************/
+#include <stdlib.h>
+#include <SDL.h>
+
+#define BATCH_MAX_TEXTURES 8            // Textures per flush; pushing a 9th texture flushes early
+
+typedef struct
+{
+    SDL_Texture *tex;
+    float inv_w, inv_h;                 // 1/texture size, for texture coordinates
+    SDL_Vertex *v;                      // 4 vertices per quad
+    int nquads;
+} BatchBucket;
+
+typedef struct
+{
+    SDL_Renderer *ren;
+    BatchBucket bucket[BATCH_MAX_TEXTURES];
+    int nbuckets;
+    int cap;                            // Quads per bucket before growing
+    int *idx;                           // 6 indices per quad, same for every bucket
+    SDL_Color color;                    // Vertex color (tint). White draws the texture as-is.
+} SpriteBatch;
+
+void batch_init(SpriteBatch *batch)
+{
+    batch->ren = NULL;
+    batch->nbuckets = 0;
+    batch->cap = 0;
+    batch->idx = NULL;
+    batch->color = (SDL_Color){255,255,255,255};
+    for( int b=0; b<BATCH_MAX_TEXTURES; b++ ) batch->bucket[b] = (BatchBucket){0};
+}
+
+void batch_free(SpriteBatch *batch)
+{
+    for( int b=0; b<BATCH_MAX_TEXTURES; b++ ) free(batch->bucket[b].v);
+    free(batch->idx);
+    batch_init(batch);
+}
+
+bool batch_grow(SpriteBatch *batch, int cap)
+{ // Make room for cap quads in every bucket. Return false if out of memory.
+    if(  cap <= batch->cap  ) return true;
+    int *idx = realloc(batch->idx, 6*cap*sizeof(int));
+    if(  idx == NULL  ) return false;
+    batch->idx = idx;
+    for( int q=batch->cap; q<cap; q++ )
+    { // Two triangles per quad: 0-1-2 and 0-2-3
+        int *k = &idx[6*q]; int i = 4*q;
+        k[0]=i; k[1]=i+1; k[2]=i+2; k[3]=i; k[4]=i+2; k[5]=i+3;
+    }
+    for( int b=0; b<BATCH_MAX_TEXTURES; b++ )
+    {
+        SDL_Vertex *v = realloc(batch->bucket[b].v, 4*cap*sizeof(SDL_Vertex));
+        if(  v == NULL  ) return false;
+        batch->bucket[b].v = v;
+    }
+    batch->cap = cap;
+    return true;
+}
+
+void batch_begin(SpriteBatch *batch, SDL_Renderer *ren)
+{ // Start collecting sprites for ren
+    batch->ren = ren;
+    batch->nbuckets = 0;
+}
+
+void batch_flush(SpriteBatch *batch)
+{ // Draw every collected sprite: one SDL_RenderGeometry call per texture
+    for( int b=0; b<batch->nbuckets; b++ )
+    {
+        BatchBucket *bk = &batch->bucket[b];
+        if(  bk->nquads == 0  ) continue;
+        SDL_RenderGeometry(batch->ren, bk->tex, bk->v, 4*bk->nquads, batch->idx, 6*bk->nquads);
+        bk->nquads = 0;
+    }
+    batch->nbuckets = 0;
+}
+
+BatchBucket *batch_bucket(SpriteBatch *batch, SDL_Texture *tex)
+{ // Return the bucket for tex. Flush to free a bucket if all are taken.
+    for( int b=0; b<batch->nbuckets; b++ )
+    {
+        if(  batch->bucket[b].tex == tex  ) return &batch->bucket[b];
+    }
+    if(  batch->nbuckets == BATCH_MAX_TEXTURES  ) batch_flush(batch);
+    BatchBucket *bk = &batch->bucket[batch->nbuckets++];
+    int w = 1, h = 1;
+    SDL_QueryTexture(tex, NULL, NULL, &w, &h);
+    bk->tex = tex;
+    bk->inv_w = 1.0f/(float)w; bk->inv_h = 1.0f/(float)h;
+    bk->nquads = 0;
+    return bk;
+}
+
+void batch_push(SpriteBatch *batch, SDL_Texture *tex, const SDL_Rect *src, const SDL_Rect *dst,
+                SDL_RendererFlip flip)
+{ // Add one sprite: copy src (in tex) to dst (on screen), flipped
+    BatchBucket *bk = batch_bucket(batch, tex);
+    if(  bk->nquads == batch->cap  )
+    { // Double the room in every bucket
+        if(  batch_grow(batch, (batch->cap > 0) ? 2*batch->cap : 256) == false  ) return;
+    }
+    float x0 = (float)dst->x;         float y0 = (float)dst->y;
+    float x1 = x0 + (float)dst->w;    float y1 = y0 + (float)dst->h;
+    float u0 = src->x*bk->inv_w;      float v0 = src->y*bk->inv_h;
+    float u1 = (src->x+src->w)*bk->inv_w; float v1 = (src->y+src->h)*bk->inv_h;
+    if(  flip & SDL_FLIP_HORIZONTAL  ) { float t = u0; u0 = u1; u1 = t; }
+    if(  flip & SDL_FLIP_VERTICAL  )   { float t = v0; v0 = v1; v1 = t; }
+    SDL_Color c = batch->color;
+    SDL_Vertex *q = &bk->v[4*bk->nquads++];
+    q[0] = (SDL_Vertex){{x0,y0}, c, {u0,v0}};
+    q[1] = (SDL_Vertex){{x1,y0}, c, {u1,v0}};
+    q[2] = (SDL_Vertex){{x1,y1}, c, {u1,v1}};
+    q[3] = (SDL_Vertex){{x0,y1}, c, {u0,v1}};
+}
+
+#endif // __BATCH_H__
@@ -0,0 +1,363 @@
+/* *************DOC***************
+ * Headless benchmark of the sprite pipeline. No display or GPU:
+ * runs on SDL's offscreen (or dummy) video driver with the software
+ * renderer, e.g., on a CI box.
+ *
+ * Example
+ * -------
+ * ./bench.exe bench.json 50 1,100,1000,10000 800x600,1920x1080
+ *
+ * Arguments
+ * ---------
+ * 1 : JSON file to write (default: bench.json)
+ * 2 : iterations per benchmark (default: 50)
+ * 3 : sprite counts for the render benchmark (default: 1,100,1000,10000)
+ * 4 : window sizes for the background and render benchmarks
+ *     (default: 800x600,1920x1080)
+ *
+ * Benchmarks
+ * ----------
+ * sheet_load       : decode a sprite sheet png (sprite_load_surface)
+ * frame_detect     : analyze a decoded sheet (sprite_load_info)
+ * bgnd_gradient    : make the background texture (bgnd_gradient)
+ * bgnd_copy        : draw the background texture (SDL_RenderCopy)
+ * bgnd_quad        : draw the background as one quad (bgnd_draw_quad)
+ * overlay_text     : build the debug overlay text and lay it out
+ * render_sprites   : one frame of the game loop with N penguins
+ *                    (background, sprite batch, present)
+ * collide_sprites  : every pair of the N penguins that touch, by
+ *                    visible pixels (collide_all), up to
+ *                    BENCH_COLLIDE_MAX penguins
+ *
+ * Each result has min/avg/p50/p99/max milliseconds per iteration.
+ * The video driver and renderer are chosen with the usual SDL
+ * variables, e.g., SDL_VIDEODRIVER=dummy ./bench.exe
+ * *******************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <SDL.h>
+#include <SDL_ttf.h>
+#include <SDL_image.h>
+#include "window_info.h"
+#include "bgnd.h"
+#include "font.h"
+#include "text.h"
+#include "sprite.h"
+#include "atlas.h"
+#include "batch.h"
+#include "anims.h"
+#include "prof.h"
+#include "overlay.h"
+#include "collide.h"
+
+#define BENCH_MAX_ITERS 1000
+#define BENCH_MAX_PARAMS 16
+#define BENCH_COLLIDE_MAX 1000          // A bigger crowd on one screen touches in almost every pair
+
+typedef struct
+{
+    Uint64 freq;
+    Uint64 start;
+    int n;                              // Samples taken
+    double ms[BENCH_MAX_ITERS];
+} BenchTimer;
+
+void bench_reset(BenchTimer *t)
+{
+    t->freq = SDL_GetPerformanceFrequency();
+    t->n = 0;
+}
+
+void bench_start(BenchTimer *t)
+{
+    t->start = SDL_GetPerformanceCounter();
+}
+
+void bench_stop(BenchTimer *t)
+{
+    Uint64 now = SDL_GetPerformanceCounter();
+    if(  t->n < BENCH_MAX_ITERS  ) t->ms[t->n++] = 1000.0*(double)(now - t->start)/(double)t->freq;
+}
+
+int compare_doubles(const void *a, const void *b)
+{
+    double da = *(const double *)a; double db = *(const double *)b;
+    return (da > db) - (da < db);
+}
+
+bool first_result = true;
+
+void bench_report(FILE *f, BenchTimer *t, const char *name, const char *params)
+{ // Write one JSON result. params is the inside of a JSON object, e.g., "\"w\":800,\"h\":600"
+    if(  t->n == 0  ) return;
+    qsort(t->ms, t->n, sizeof(double), compare_doubles);
+    double sum = 0;
+    for( int i=0; i<t->n; i++ ) sum += t->ms[i];
+    fprintf(f, "%s    {\"name\":\"%s\",\"params\":{%s},\"iters\":%d,"
+               "\"min_ms\":%.4f,\"avg_ms\":%.4f,\"p50_ms\":%.4f,\"p99_ms\":%.4f,\"max_ms\":%.4f}",
+            first_result ? "" : ",\n", name, params, t->n,
+            t->ms[0], sum/t->n, t->ms[t->n/2], t->ms[(t->n*99)/100], t->ms[t->n-1]);
+    first_result = false;
+    fprintf(stderr, "%-16s %-40s avg %8.3f ms\n", name, params, sum/t->n);
+}
+
+int parse_ints(const char *arg, int *vals)
+{ // "1,100,1000" -> {1,100,1000}. Return the count.
+    int n = 0;
+    const char *c = arg;
+    while(  (*c != '\0') && (n < BENCH_MAX_PARAMS)  )
+    {
+        vals[n++] = atoi(c);
+        while(  (*c != '\0') && (*c != ',')  ) c++;
+        if(  *c == ','  ) c++;
+    }
+    return n;
+}
+
+int parse_sizes(const char *arg, WindowInfo *sizes)
+{ // "800x600,1920x1080" -> window sizes. Return the count.
+    int n = 0;
+    const char *c = arg;
+    while(  (*c != '\0') && (n < BENCH_MAX_PARAMS)  )
+    {
+        int w = 0, h = 0;
+        if(  sscanf(c, "%dx%d", &w, &h) == 2  ) sizes[n++] = (WindowInfo){.w=w, .h=h};
+        while(  (*c != '\0') && (*c != ',')  ) c++;
+        if(  *c == ','  ) c++;
+    }
+    return n;
+}
+
+SDL_Renderer *bench_renderer(SDL_Window **win, SDL_Surface **target, int w, int h)
+{ // Software renderer in a hidden window. Without a window, render to a surface.
+    *win = SDL_CreateWindow("bench", 0, 0, w, h, SDL_WINDOW_HIDDEN);
+    *target = NULL;
+    SDL_Renderer *ren = (*win != NULL) ? SDL_CreateRenderer(*win, -1, SDL_RENDERER_SOFTWARE) : NULL;
+    if(  ren == NULL  )
+    {
+        *target = SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, SDL_PIXELFORMAT_ARGB8888);
+        if(  *target != NULL  ) ren = SDL_CreateSoftwareRenderer(*target);
+    }
+    if(  ren != NULL  ) SDL_SetRenderDrawBlendMode(ren, SDL_BLENDMODE_BLEND);
+    return ren;
+}
+
+void bench_close_renderer(SDL_Window *win, SDL_Surface *target, SDL_Renderer *ren)
+{
+    SDL_DestroyRenderer(ren);
+    SDL_FreeSurface(target);
+    if(  win != NULL  ) SDL_DestroyWindow(win);
+}
+
+void bench_count_pair(int i, int j, void *data)
+{ // collide_all callback: nothing to do, collide_all returns the count
+    (void)i; (void)j; (void)data;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *out_path = (argc>1) ? argv[1] : "bench.json";
+    int iters = (argc>2) ? atoi(argv[2]) : 50;
+    if(  iters < 1  ) iters = 1;
+    if(  iters > BENCH_MAX_ITERS  ) iters = BENCH_MAX_ITERS;
+    int counts[BENCH_MAX_PARAMS];
+    int ncounts = parse_ints((argc>3) ? argv[3] : "1,100,1000,10000", counts);
+    WindowInfo sizes[BENCH_MAX_PARAMS];
+    int nsizes = parse_sizes((argc>4) ? argv[4] : "800x600,1920x1080", sizes);
+
+    // Headless video: offscreen, else dummy (SDL_VIDEODRIVER in the environment wins)
+    const char *drivers[] = {"offscreen", "dummy"};
+    bool video = false;
+    for( int i=0; (i<2) && (video == false); i++ )
+    {
+        SDL_SetHint(SDL_HINT_VIDEODRIVER, drivers[i]);
+        video = (SDL_Init(SDL_INIT_VIDEO) == 0);
+        if(  video == false  ) { fprintf(stderr, "No \"%s\" video driver: %s\n", drivers[i], SDL_GetError()); SDL_Quit(); }
+    }
+    if(  video == false  ) return EXIT_FAILURE;
+    if(  (font_init() < 0) || (IMG_Init(IMG_INIT_PNG) == 0)  ) { SDL_Quit(); return EXIT_FAILURE; }
+    TTF_Font *font;
+    if(  font_load(&font, "fonts/ProggyClean.ttf", 16) < 0  ) { TTF_Quit(); SDL_Quit(); return EXIT_FAILURE; }
+
+    FILE *f = fopen(out_path, "w");
+    if(  f == NULL  )
+    {
+        fprintf(stderr, "Cannot write \"%s\"\n", out_path);
+        TTF_CloseFont(font); TTF_Quit(); SDL_Quit();
+        return EXIT_FAILURE;
+    }
+    SDL_version v; SDL_GetVersion(&v);
+    fprintf(f, "{\n  \"video_driver\":\"%s\",\n  \"sdl\":\"%d.%d.%d\",\n  \"iters\":%d,\n  \"results\":[\n",
+            SDL_GetCurrentVideoDriver(), v.major, v.minor, v.patch, iters);
+
+    static BenchTimer t;
+    char params[256];
+    Sprite *sprite_mem = calloc(2, sizeof(Sprite));             // Sprite is big: keep off the stack
+    Sprite *sprites[2] = {&sprite_mem[0], &sprite_mem[1]};
+    sprites[0]->path = "art/penguin-huff.png";
+    sprites[1]->path = "art/penguin-waddle.png";
+    SDL_Surface *sheets[2] = {NULL, NULL};
+    int err = 0;
+
+    for( int s=0; s<2; s++ )
+    { // Sheet loading and frame detection
+        bench_reset(&t);
+        for( int i=0; i<iters; i++ )
+        {
+            SDL_FreeSurface(sheets[s]);
+            bench_start(&t); sheets[s] = sprite_load_surface(sprites[s]->path); bench_stop(&t);
+            if(  sheets[s] == NULL  ) { err = -1; break; }
+        }
+        if(  err < 0  ) break;
+        snprintf(params, sizeof(params), "\"sheet\":\"%s\",\"w\":%d,\"h\":%d",
+                 sprites[s]->path, sheets[s]->w, sheets[s]->h);
+        bench_report(f, &t, "sheet_load", params);
+        bench_reset(&t);
+        for( int i=0; i<iters; i++ )
+        {
+            bench_start(&t); sprite_load_info(sprites[s], sheets[s]); bench_stop(&t);
+        }
+        bench_report(f, &t, "frame_detect", params);
+    }
+
+    for( int z=0; (z<nsizes) && (err==0); z++ )
+    { // Everything that depends on the window size
+        WindowInfo wI = sizes[z];
+        SDL_Window *win; SDL_Surface *target;
+        SDL_Renderer *ren = bench_renderer(&win, &target, wI.w, wI.h);
+        if(  ren == NULL  ) { fprintf(stderr, "Cannot create renderer: %s\n", SDL_GetError()); err = -1; break; }
+        if(  z == 0  )
+        {
+            SDL_RendererInfo info; SDL_GetRendererInfo(ren, &info);
+            fprintf(stderr, "Video driver: %s, renderer: %s\n", SDL_GetCurrentVideoDriver(), info.name);
+        }
+        snprintf(params, sizeof(params), "\"w\":%d,\"h\":%d", wI.w, wI.h);
+
+        SDL_Texture *bgnd_tex = NULL;
+        bench_reset(&t);
+        for( int i=0; i<iters; i++ )
+        {
+            SDL_DestroyTexture(bgnd_tex);
+            bench_start(&t); bgnd_gradient(&bgnd_tex, ren, wI); bench_stop(&t);
+        }
+        bench_report(f, &t, "bgnd_gradient", params);
+
+        { // Draw the background: copy the texture, or one vertex-colored quad
+            bench_reset(&t);
+            for( int i=0; i<iters; i++ )
+            {
+                bench_start(&t); SDL_RenderCopy(ren, bgnd_tex, NULL, NULL); SDL_RenderPresent(ren); bench_stop(&t);
+            }
+            bench_report(f, &t, "bgnd_copy", params);
+            bench_reset(&t);
+            for( int i=0; i<iters; i++ )
+            {
+                bench_start(&t); int ret = bgnd_draw_quad(ren, wI.w, wI.h); SDL_RenderPresent(ren); bench_stop(&t);
+                if(  ret < 0  ) { t.n = 0; break; }             // No geometry: no result
+            }
+            bench_report(f, &t, "bgnd_quad", params);
+        }
+
+        { // Overlay text: build it and lay it out, as in the game loop
+            GlyphAtlas glyphs;
+            bool use_atlas = (font_atlas_build(&glyphs, ren, font) == 0);
+            static Profiler prof; prof_init(&prof);
+            char text_buffer[1024];
+            Overlay overlay; overlay_init(&overlay, text_buffer, sizeof(text_buffer));
+            TextBox tb = {.text=text_buffer, .margin=5, .fg={255,255,255,255}, .bg={0,0,0,127},
+                          .atlas=use_atlas ? &glyphs : NULL};
+            tb.fg_rect.x = tb.margin; tb.fg_rect.y = tb.margin; tb.bg_rect.w = wI.w;
+            bench_reset(&t);
+            for( int i=0; i<iters; i++ )
+            { // The frame number changes every iteration, so the layout is never cached
+                prof_begin_frame(&prof);
+                bench_start(&t);
+                overlay_text(&overlay, sprites[0], 1 + i%sprites[0]->framecnt,
+                             false, wI, "", -1, &prof);
+                textbox_update(&tb, ren, font, wI.w-tb.margin);
+                textbox_draw(&tb, ren);
+                bench_stop(&t);
+            }
+            snprintf(params, sizeof(params), "\"w\":%d,\"h\":%d,\"glyph_atlas\":%s",
+                     wI.w, wI.h, use_atlas ? "true" : "false");
+            bench_report(f, &t, "overlay_text", params);
+            textbox_free(&tb);
+            if(  use_atlas  ) font_atlas_free(&glyphs);
+        }
+
+        { // N sprites: one game loop frame (background, batch, present)
+            Atlas atlas; atlas_init(&atlas, 0, 0);
+            for( int s=0; s<2; s++ ) sprite_load_info(sprites[s], sheets[s]); // Sheet frame rects again
+            if(  atlas_build(&atlas, ren, sprites, sheets, 2) < 0  )
+            {
+                for( int s=0; s<2; s++ ) err |= sprite_load_texture(sprites[s], ren, sheets[s]);
+            }
+            AnimSystem anims;
+            SpriteBatch batch; batch_init(&batch);
+            for( int c=0; (c<ncounts) && (err==0); c++ )
+            {
+                if(  anims_init(&anims, counts[c]) < 0  ) { err = -1; break; }
+                int clip_PI = anims_add_clip(&anims, sprites[0]);
+                int clip_PW = anims_add_clip(&anims, sprites[1]);
+                srand(1);                                       // Same crowd every run
+                for( int i=0; i<counts[c]; i++ )
+                {
+                    int k = anims_add(&anims, (i%2) ? clip_PW : clip_PI,
+                                      rand()%wI.w, rand()%wI.h);
+                    anims.dir[k] = (i%4 < 2) ? 1 : -1;
+                }
+                bench_reset(&t);
+                for( int i=0; i<iters; i++ )
+                {
+                    bench_start(&t);
+                    anims_tick(&anims);
+                    SDL_RenderCopy(ren, bgnd_tex, NULL, NULL);
+                    batch_begin(&batch, ren);
+                    anims_draw(&anims, &batch, 0);
+                    batch_flush(&batch);
+                    SDL_RenderPresent(ren);
+                    bench_stop(&t);
+                }
+                snprintf(params, sizeof(params), "\"w\":%d,\"h\":%d,\"sprites\":%d", wI.w, wI.h, counts[c]);
+                bench_report(f, &t, "render_sprites", params);
+                if(  counts[c] <= BENCH_COLLIDE_MAX  )
+                { // Broad and narrow phase over the crowd as it is after the render frames
+                    Collider col; collide_init(&col);
+                    int pairs = 0;
+                    bench_reset(&t);
+                    for( int i=0; i<iters; i++ )
+                    {
+                        bench_start(&t); pairs = collide_all(&col, &anims, 0, bench_count_pair, NULL); bench_stop(&t);
+                        anims_tick(&anims);                     // Some penguins show their next frame
+                    }
+                    if(  pairs < 0  ) err = -1;
+                    snprintf(params, sizeof(params), "\"w\":%d,\"h\":%d,\"sprites\":%d,\"pairs\":%d",
+                             wI.w, wI.h, counts[c], pairs);
+                    bench_report(f, &t, "collide_sprites", params);
+                    collide_free(&col);
+                }
+                anims_free(&anims);
+            }
+            batch_free(&batch);
+            if(  atlas.tex != NULL  ) atlas_free(&atlas);
+            else for( int s=0; s<2; s++ ) SDL_DestroyTexture(sprites[s]->tex);
+            for( int s=0; s<2; s++ ) sprites[s]->tex = NULL;
+        }
+        SDL_DestroyTexture(bgnd_tex);
+        bench_close_renderer(win, target, ren);
+    }
+    fprintf(f, "\n  ]\n}\n");
+    fclose(f);
+    fprintf(stderr, "Wrote \"%s\"\n", out_path);
+
+    // Shutdown
+    for( int s=0; s<2; s++ ) { SDL_FreeSurface(sheets[s]); free(sprites[s]->mask); }
+    free(sprite_mem);
+    TTF_CloseFont(font);
+    TTF_Quit();
+    IMG_Quit();
+    SDL_Quit();
+    return (err == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -1,31 +1,242 @@
 #ifndef __BGND_H__
 #define __BGND_H__
+/* *************Background gradient***************
+ * Paint a beautiful background gradient: into a texture, or as one quad.
+ *
+ * The red channel only depends on the row, green and blue only on
+ * the column. So the divisions are done once per row and once per
+ * column (two small tables), and each pixel is row_color | col_color.
+ * The OR runs 8 (AVX2) or 4 (SSE2) pixels at a time, and the rows are
+ * split across threads.
+ *
+ * Example: make the texture now (blocks)
+ *      SDL_Texture *bgnd_tex;
+ *      bgnd_gradient(&bgnd_tex, ren, wI);
+ *
+ * Example: remake the texture after a window resize (does not block)
+ *      BgndJob bgnd_job; bgnd_job_init(&bgnd_job);
+ *      ...
+ *      case SDL_WINDOWEVENT_SIZE_CHANGED:
+ *          bgnd_request(&bgnd_job, e.window.data1, e.window.data2);
+ *      ...
+ *      bgnd_poll(&bgnd_job, &bgnd_tex, ren);   // Every frame: swap in the new texture when ready
+ *      ...
+ *      bgnd_job_free(&bgnd_job);
+ *
+ * Until the new texture is ready, the old texture is stretched to
+ * fill the window.
+ *
+ * Example: no texture at all (draw every frame)
+ *      if(  bgnd_draw_quad(ren, wI.w, wI.h) < 0  ) ... fall back to the texture ...
+ *
+ * Every channel is a straight line across the window (red from top
+ * to bottom, green and blue from left to right), so the GPU draws
+ * the same gradient from one quad with a color at each corner. No
+ * texture memory, no fill from a texture, nothing to remake on
+ * resize. The corner colors do not depend on the window size.
+ * *******************************/
+#include <stdlib.h>
 #include <SDL.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define BGND_MAX_THREADS 8              // Max threads per gradient
+#define BGND_MIN_ROWS 128               // Do not start a thread for fewer rows than this
+
+typedef struct
+{
+    uint32_t *pixels;                   // First pixel of row 0
+    int pitch;                          // Pixels from one row to the next
+    int w;
+    int row0, row1;                     // Fill rows row0 to row1-1
+    const uint32_t *row_c;              // Color bits that depend on the row
+    const uint32_t *col_c;              // Color bits that depend on the column
+} BgndBand;
+
+void bgnd_tables(uint32_t *row_c, uint32_t *col_c, int w, int h)
+{ // Gradient colors: red and alpha per row, green and blue per column
+    uint32_t vstart = 2*h; uint32_t hstart = 3*w;              // initial gradient brightness
+    for( int row=0; row<h; row++ )
+    {
+        uint32_t r = ((row+vstart)*255/(h+vstart));
+        row_c[row] = (0xFFu << 24) | (r << 16);
+    }
+    for( int col=0; col<w; col++ )
+    {
+        uint32_t g = ((col+hstart)*200/(w+hstart));
+        uint32_t b = ((col+hstart)*255/(w+hstart));
+        col_c[col] = (g << 8) | b;
+    }
+}
+
+int bgnd_fill_band(void *data)
+{ // Fill one band of rows (also the thread function)
+    const BgndBand *band = data;
+    const uint32_t *col_c = band->col_c;
+    for( int row=band->row0; row<band->row1; row++ )
+    {
+        uint32_t *p = band->pixels + row*band->pitch;
+        uint32_t rc = band->row_c[row];
+        int col = 0;
+#if defined(__AVX2__)
+        __m256i v = _mm256_set1_epi32((int)rc);
+        for( ; col+8 <= band->w; col+=8 )
+        {
+            _mm256_storeu_si256((__m256i *)(p+col),
+                                _mm256_or_si256(v, _mm256_loadu_si256((const __m256i *)(col_c+col))));
+        }
+#elif defined(__SSE2__)
+        __m128i v = _mm_set1_epi32((int)rc);
+        for( ; col+4 <= band->w; col+=4 )
+        {
+            _mm_storeu_si128((__m128i *)(p+col),
+                             _mm_or_si128(v, _mm_loadu_si128((const __m128i *)(col_c+col))));
+        }
+#endif
+        for( ; col<band->w; col++ ) p[col] = rc | col_c[col];   // Leftover pixels
+    }
+    return 0;
+}
+
+SDL_Surface *bgnd_gradient_surface(int w, int h)
+{ // Return a w x h surface with the gradient, or NULL. Safe to call from any thread.
+    //                                    flags, w,  h, bit-depth, masks
+    SDL_Surface *surf = SDL_CreateRGBSurface(0, w, h, 32, 0xFF0000, 0xFF00, 0xFF, 0xFF000000);
+    if(  surf == NULL  ) return NULL;
+    uint32_t *tables = malloc((h + w)*sizeof(uint32_t));
+    if(  tables == NULL  ) { SDL_FreeSurface(surf); return NULL; }
+    uint32_t *row_c = tables; uint32_t *col_c = tables + h;
+    bgnd_tables(row_c, col_c, w, h);
+    int nbands = SDL_GetCPUCount();
+    if(  nbands > BGND_MAX_THREADS  ) nbands = BGND_MAX_THREADS;
+    if(  nbands > h/BGND_MIN_ROWS  ) nbands = h/BGND_MIN_ROWS;
+    if(  nbands < 1  ) nbands = 1;
+    BgndBand band[BGND_MAX_THREADS];
+    SDL_Thread *thread[BGND_MAX_THREADS] = {NULL};
+    for( int i=0; i<nbands; i++ )
+    {
+        band[i] = (BgndBand){.pixels=surf->pixels, .pitch=surf->pitch/4, .w=w,
+                             .row0=h*i/nbands, .row1=h*(i+1)/nbands, .row_c=row_c, .col_c=col_c};
+    }
+    for( int i=1; i<nbands; i++ )
+    { // Band 0 runs on this thread. If a thread does not start, this thread fills its band.
+        thread[i] = SDL_CreateThread(bgnd_fill_band, "bgnd", &band[i]);
+    }
+    bgnd_fill_band(&band[0]);
+    for( int i=1; i<nbands; i++ )
+    {
+        if(  thread[i] != NULL  ) SDL_WaitThread(thread[i], NULL);
+        else bgnd_fill_band(&band[i]);
+    }
+    free(tables);
+    return surf;
+}
+
+SDL_Texture *bgnd_texture(SDL_Renderer *ren, SDL_Surface *surf)
+{ // Upload the gradient. Main thread only (the renderer is not thread-safe).
+    SDL_Texture *tex = SDL_CreateTextureFromSurface(ren, surf);
+    if(  tex != NULL  ) SDL_SetTextureBlendMode(tex, SDL_BLENDMODE_BLEND);
+    return tex;
+}
 
 void bgnd_gradient(SDL_Texture **bgnd_tex, SDL_Renderer *ren, WindowInfo wI)
     { // Paint a beautiful background gradient
-        //                                    flags, w,  h, bit-depth, masks
-        SDL_Surface *surf = SDL_CreateRGBSurface(0, wI.w, wI.h, 32, 0xFF0000, 0xFF00, 0xFF, 0xFF000000);
-        // Fill this surface with a beautiful complex gradient
-        uint32_t vstart = 2*wI.h; uint32_t hstart = 3*wI.w;    // initial gradient brightness
-        uint32_t *p = surf->pixels;
-        for( int row=0; row < surf->h; row++ )                    // Walk rows
+        SDL_Surface *surf = bgnd_gradient_surface(wI.w, wI.h);
+        *bgnd_tex = (surf != NULL) ? bgnd_texture(ren, surf) : NULL;
+        SDL_FreeSurface(surf);
+    }
+
+int bgnd_draw_quad(SDL_Renderer *ren, int w, int h)
+{ // Draw the gradient as one vertex-colored quad. Return -1 if the renderer cannot draw geometry.
+    /* *************DOC***************
+     * Corner colors are bgnd_tables() at the window edges:
+     *      red   = (row + 2h)*255/3h : 170 at the top, 255 at the bottom
+     *      green = (col + 3w)*200/4w : 150 at the left, 200 at the right
+     *      blue  = (col + 3w)*255/4w : 191 at the left, 255 at the right
+     * Interpolating across two triangles is exact for colors that
+     * are straight lines in x and y.
+     * *******************************/
+    float x1 = (float)w; float y1 = (float)h;
+    SDL_Vertex v[4] = {
+        {{ 0, 0}, {170,150,191,255}, {0,0}},                    // Top-left
+        {{x1, 0}, {170,200,255,255}, {0,0}},                    // Top-right
+        {{x1,y1}, {255,200,255,255}, {0,0}},                    // Bottom-right
+        {{ 0,y1}, {255,150,191,255}, {0,0}},                    // Bottom-left
+    };
+    const int idx[6] = {0,1,2, 0,2,3};
+    return SDL_RenderGeometry(ren, NULL, v, 4, idx, 6);
+}
+
+typedef struct
+{ // Make the gradient on a thread after a resize
+    SDL_Thread *thread;                 // NULL : no job running
+    SDL_atomic_t done;                  // 1 : thread finished, surf is ready
+    int w, h;                           // Size of the running job
+    SDL_Surface *surf;                  // Result of the running job
+    int want_w, want_h;                 // Latest requested size
+} BgndJob;
+
+void bgnd_job_init(BgndJob *job)
+{
+    *job = (BgndJob){0};
+}
+
+int bgnd_job_run(void *data)
+{ // Thread function
+    BgndJob *job = data;
+    job->surf = bgnd_gradient_surface(job->w, job->h);
+    SDL_AtomicSet(&job->done, 1);
+    return 0;
+}
+
+void bgnd_job_start(BgndJob *job)
+{
+    job->w = job->want_w; job->h = job->want_h;
+    job->surf = NULL;
+    SDL_AtomicSet(&job->done, 0);
+    job->thread = SDL_CreateThread(bgnd_job_run, "bgnd_job", job);
+    if(  job->thread == NULL  ) bgnd_job_run(job);             // No thread: make it now
+}
+
+void bgnd_request(BgndJob *job, int w, int h)
+{ // Ask for a w x h gradient. Call from the main thread, e.g., on SDL_WINDOWEVENT_SIZE_CHANGED.
+    if(  (w <= 0) || (h <= 0)  ) return;
+    job->want_w = w; job->want_h = h;
+    if(  (job->thread == NULL) && (SDL_AtomicGet(&job->done) == 0)  ) bgnd_job_start(job);
+    // Else a job is running: bgnd_poll starts the latest size when it finishes
+}
+
+bool bgnd_poll(BgndJob *job, SDL_Texture **bgnd_tex, SDL_Renderer *ren)
+{ // Call every frame. Return true if *bgnd_tex was replaced by a new gradient.
+    if(  SDL_AtomicGet(&job->done) == 0  ) return false;
+    if(  job->thread != NULL  ) SDL_WaitThread(job->thread, NULL);
+    job->thread = NULL;
+    SDL_AtomicSet(&job->done, 0);
+    bool swapped = false;
+    if(  (job->w == job->want_w) && (job->h == job->want_h)  )
+    { // Still the size we want
+        SDL_Texture *tex = (job->surf != NULL) ? bgnd_texture(ren, job->surf) : NULL;
+        if(  tex != NULL  )
         {
-            for( int col=0; col < surf->w; col++ )                // Walk columns
-            {
-                uint32_t r, g, b, c32;
-                { // Calculate the color
-                    r = ((row+vstart)*255/(wI.h+vstart));
-                    g = ((col+hstart)*200/(wI.w+hstart));
-                    b = ((col+hstart)*255/(wI.w+hstart));
-                    c32 = (0xFF << 24) | (r << 16) | (g << 8) | b;
-                }
-                *p++ = c32;
-            }
+            SDL_DestroyTexture(*bgnd_tex);
+            *bgnd_tex = tex;
+            swapped = true;
         }
-        *bgnd_tex = SDL_CreateTextureFromSurface(ren, surf);
-        SDL_SetTextureBlendMode(*bgnd_tex, SDL_BLENDMODE_BLEND);
-        SDL_FreeSurface(surf);
     }
+    SDL_FreeSurface(job->surf);
+    job->surf = NULL;
+    if(  (job->w != job->want_w) || (job->h != job->want_h)  ) bgnd_job_start(job); // Resized again
+    return swapped;
+}
+
+void bgnd_job_free(BgndJob *job)
+{ // Wait for a running job and drop its result
+    if(  job->thread != NULL  ) SDL_WaitThread(job->thread, NULL);
+    SDL_FreeSurface(job->surf);
+    bgnd_job_init(job);
+}
 
 #endif // __BGND_H__
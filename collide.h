@@ -0,0 +1,222 @@
+#ifndef __COLLIDE_H__
+#define __COLLIDE_H__
+/* *************Pixel collision***************
+ * Hit-test and collide instances of an AnimSystem by their visible
+ * pixels, not their rects.
+ *
+ * Each Sprite keeps a 1-bit alpha mask of every frame (see
+ * sprite_build_masks). Two instances collide if a visible pixel of
+ * one is drawn on a visible pixel of the other:
+ *
+ *  - Narrow phase (collide_pair): only the rows where the two render
+ *    rects overlap are tested. Each row of each instance is turned
+ *    into bits in screen space (scale and flip applied), then the two
+ *    rows are ANDed 64 pixels at a time. An unscaled, unflipped row
+ *    is two shifts per word. At scale 2 or more, a mask row covers
+ *    several screen rows: it is only built and tested once.
+ *  - Broad phase (collide_all): sweep and prune. Render rects are
+ *    sorted by left edge, then each rect is only checked against the
+ *    rects that start before it ends. The sort order is kept between
+ *    calls: characters barely move in one frame, so the insertion
+ *    sort has almost nothing to do.
+ *
+ * Positions are interpolated like the draw (alpha, see
+ * anims_render_rect), so what collides is what is on screen.
+ * A sprite without masks (out of memory) collides by its frame rects.
+ *
+ * Example:
+ *      int hit = collide_hit(view, mouse_x, mouse_y, alpha); // Top instance under the mouse, -1 : none
+ *
+ *      Collider col; collide_init(&col);
+ *      collide_all(&col, view, alpha, on_hit, data);   // on_hit(i, j, data) for every colliding pair
+ *      ...
+ *      collide_free(&col);
+ * *******************************/
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <SDL.h>
+#include "sprite.h"
+#include "anims.h"
+
+#define COLLIDE_ROW_WORDS 64            // Screen pixels tested per pass : 64 words of 64 bits
+
+typedef void (*CollideFn)(int i, int j, void *data);
+
+typedef struct
+{
+    int n;                              // Instances sorted last call
+    int cap;
+    SDL_Rect *rect;                     // Render rect of each instance
+    int *order;                         // Instances by left edge of rect
+} Collider;
+
+bool collide_mask_bit(const Sprite *sprite, int f, int mx, int my)
+{ // Pixel mx,my of frame f (0-based, in frame_rect) is visible
+    if(  sprite->mask == NULL  ) return true;                  // No masks : the whole rect
+    const uint64_t *row = sprite->mask + sprite->mask_at[f] + my*sprite_mask_words(sprite, f);
+    return (row[mx/64] >> (mx%64)) & 1u;
+}
+
+void collide_row_bits(const AnimSystem *anims, int i, const SDL_Rect *render, int sy, int sx, int n, uint64_t *bits)
+{ // Visible pixels of instance i on screen row sy, columns sx to sx+n-1 (inside render) : bit k is column sx+k
+    const Sprite *sprite = anims->clips[anims->clip[i]];
+    int f = anims->framenum[i] - 1;
+    int w = sprite->frame_rect[f].w;
+    int scale = anims->scale[i];
+    bool flip = (anims->dir[i] != 1);
+    int my = (sy - render->y)/scale;
+    int c0 = sx - render->x;                                    // Column in render
+    int nwords = (n + 63)/64;
+    if(  sprite->mask == NULL  )
+    {
+        for( int k=0; k<nwords; k++ ) bits[k] = ~(uint64_t)0;
+    }
+    else if(  (scale == 1) && (flip == false)  )
+    { // Mask bits are screen bits : shift them into place
+        const uint64_t *row = sprite->mask + sprite->mask_at[f] + my*sprite_mask_words(sprite, f);
+        int last = sprite_mask_words(sprite, f) - 1;
+        for( int k=0; k<nwords; k++ )
+        {
+            int b = c0 + 64*k;
+            int word = b/64; int shift = b%64;
+            uint64_t lo = row[word] >> shift;
+            uint64_t hi = ((shift > 0) && (word < last)) ? row[word+1] << (64 - shift) : 0;
+            bits[k] = lo | hi;
+        }
+    }
+    else
+    { // One mask pixel covers scale screen pixels, mirrored if the instance faces left
+        for( int k=0; k<nwords; k++ ) bits[k] = 0;
+        for( int t=0; t<n; t++ )
+        {
+            int c = (c0 + t)/scale;
+            int mx = flip ? w - 1 - c : c;
+            if(  collide_mask_bit(sprite, f, mx, my)  ) bits[t/64] |= (uint64_t)1 << (t%64);
+        }
+    }
+    if(  n%64 != 0  ) bits[nwords-1] &= ((uint64_t)1 << (n%64)) - 1; // Drop columns past sx+n-1
+}
+
+bool collide_rects(const AnimSystem *anims, int i, const SDL_Rect *ri, int j, const SDL_Rect *rj)
+{ // Narrow phase : instances i and j, drawn at ri and rj, share a visible pixel
+    SDL_Rect ov;
+    if(  SDL_IntersectRect(ri, rj, &ov) == SDL_FALSE  ) return false;
+    uint64_t bi[COLLIDE_ROW_WORDS], bj[COLLIDE_ROW_WORDS];
+    for( int sx=ov.x; sx<ov.x + ov.w; sx += 64*COLLIDE_ROW_WORDS )
+    { // Very wide overlaps are tested in strips
+        int n = ov.x + ov.w - sx;
+        if(  n > 64*COLLIDE_ROW_WORDS  ) n = 64*COLLIDE_ROW_WORDS;
+        int nwords = (n + 63)/64;
+        int last_i = -1, last_j = -1;                           // Mask rows tested last
+        for( int sy=ov.y; sy<ov.y + ov.h; sy++ )
+        {
+            int my_i = (sy - ri->y)/anims->scale[i];
+            int my_j = (sy - rj->y)/anims->scale[j];
+            if(  (my_i == last_i) && (my_j == last_j)  ) continue; // Same rows as the screen row above
+            if(  my_i != last_i  ) collide_row_bits(anims, i, ri, sy, sx, n, bi);
+            if(  my_j != last_j  ) collide_row_bits(anims, j, rj, sy, sx, n, bj);
+            last_i = my_i; last_j = my_j;
+            for( int k=0; k<nwords; k++ ) if(  bi[k] & bj[k]  ) return true;
+        }
+    }
+    return false;
+}
+
+bool collide_drawn(const AnimSystem *anims, int i, const SDL_Rect *render)
+{ // Instance i has pixels to test (render is its render rect)
+    return (anims->clips[anims->clip[i]]->framecnt > 0) && (render->w > 0) && (render->h > 0);
+}
+
+bool collide_pair(const AnimSystem *anims, int i, int j, float alpha)
+{ // Instances i and j share a visible pixel on screen (alpha : see anims_render_rect)
+    SDL_Rect ri = anims_render_rect(anims, i, alpha);
+    SDL_Rect rj = anims_render_rect(anims, j, alpha);
+    if(  (collide_drawn(anims, i, &ri) == false) || (collide_drawn(anims, j, &rj) == false)  ) return false;
+    return collide_rects(anims, i, &ri, j, &rj);
+}
+
+bool collide_point(const AnimSystem *anims, int i, int x, int y, float alpha)
+{ // Screen pixel x,y is a visible pixel of instance i
+    SDL_Rect r = anims_render_rect(anims, i, alpha);
+    if(  collide_drawn(anims, i, &r) == false  ) return false;
+    if(  (x < r.x) || (y < r.y) || (x >= r.x + r.w) || (y >= r.y + r.h)  ) return false;
+    const Sprite *sprite = anims->clips[anims->clip[i]];
+    int f = anims->framenum[i] - 1;
+    int scale = anims->scale[i];
+    int c = (x - r.x)/scale;
+    int mx = (anims->dir[i] == 1) ? c : sprite->frame_rect[f].w - 1 - c;
+    return collide_mask_bit(sprite, f, mx, (y - r.y)/scale);
+}
+
+int collide_hit(const AnimSystem *anims, int x, int y, float alpha)
+{ // Top instance (drawn last) with a visible pixel at x,y, -1 if none
+    for( int i=anims->n-1; i>=0; i-- )
+    {
+        if(  collide_point(anims, i, x, y, alpha)  ) return i;
+    }
+    return -1;
+}
+
+void collide_init(Collider *col)
+{
+    *col = (Collider){0};
+}
+
+void collide_free(Collider *col)
+{
+    free(col->rect); free(col->order);
+    *col = (Collider){0};
+}
+
+int collide_all(Collider *col, const AnimSystem *anims, float alpha, CollideFn fn, void *data)
+{ // Call fn(i, j, data) (i < j) for every pair of instances that share a visible pixel. Return the pair count, -1 if out of memory.
+    int n = anims->n;
+    if(  n > col->cap  )
+    {
+        SDL_Rect *rect = realloc(col->rect, n*sizeof(SDL_Rect));
+        if(  rect == NULL  ) return -1;
+        col->rect = rect;
+        int *order = realloc(col->order, n*sizeof(int));
+        if(  order == NULL  ) return -1;
+        col->order = order;
+        col->cap = n;
+    }
+    if(  n != col->n  )
+    { // Instances were added : start from scratch
+        for( int k=0; k<n; k++ ) col->order[k] = k;
+        col->n = n;
+    }
+    for( int i=0; i<n; i++ )
+    {
+        col->rect[i] = anims_render_rect(anims, i, alpha);
+        if(  collide_drawn(anims, i, &col->rect[i]) == false  ) col->rect[i].w = 0; // Never overlaps
+    }
+    int *order = col->order; const SDL_Rect *rect = col->rect;
+    for( int k=1; k<n; k++ )
+    { // Insertion sort by left edge : last call's order is almost sorted
+        int i = order[k];
+        int m = k;
+        for( ; (m > 0) && (rect[order[m-1]].x > rect[i].x); m-- ) order[m] = order[m-1];
+        order[m] = i;
+    }
+    int pairs = 0;
+    for( int a=0; a<n; a++ )
+    { // Sweep : only rects that start left of a's right edge can overlap it
+        int i = order[a];
+        if(  rect[i].w == 0  ) continue;
+        int right = rect[i].x + rect[i].w;
+        for( int b=a+1; (b < n) && (rect[order[b]].x < right); b++ )
+        {
+            int j = order[b];
+            if(  rect[j].w == 0  ) continue;
+            if(  (rect[j].y >= rect[i].y + rect[i].h) || (rect[i].y >= rect[j].y + rect[j].h)  ) continue; // Prune on y
+            if(  collide_rects(anims, i, &rect[i], j, &rect[j]) == false  ) continue;
+            if(  i < j  ) fn(i, j, data); else fn(j, i, data);
+            pairs++;
+        }
+    }
+    return pairs;
+}
+
+#endif // __COLLIDE_H__
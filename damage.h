@@ -0,0 +1,103 @@
+#ifndef __DAMAGE_H__
+#define __DAMAGE_H__
+/* *************Idle mode***************
+ * Do not redraw a frame that would look the same as the last one.
+ *
+ * Each frame, hash what the frame would show (every character's
+ * frame rect, screen rect and direction, the overlay text inputs, the
+ * window size). Same hash as the last frame presented and nothing
+ * else marked the window damaged (expose, resize, a new sheet or
+ * background): skip the render and the present, and block in
+ * SDL_WaitEventTimeout until input arrives or the next character
+ * changes frame (anims_next_change).
+ *
+ * Example:
+ *      Damage damage; damage_init(&damage);
+ *      while(  quit == false  )
+ *      {
+ *          ... input (damage_mark on SDL_WINDOWEVENT) ... animate ...
+ *          uint64_t h = damage_hash_anims(DAMAGE_SEED, &anims, alpha);
+ *          if(  damage_changed(&damage, h)  ) { ... render, present ... }
+ *          else damage_wait(&pacing, anims_next_change(&anims), busy);
+ *      }
+ *
+ * The profiler text and graph are not in the hash: they change
+ * every frame, so the window would never be idle. They only update
+ * when something else is redrawn.
+ *
+ * Run with ALWAYS_REDRAW=1 to redraw every frame (e.g., to watch
+ * the profiler).
+ * *******************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL.h>
+#include "pacing.h"
+#include "anims.h"
+
+#define DAMAGE_SEED 14695981039346656037ull // FNV-1a 64-bit offset basis
+#define DAMAGE_MAX_WAIT_MS 250          // Longest block: PACING_MAX_FRAME, so no simulated time is dropped
+
+typedef struct
+{
+    uint64_t hash;                      // Hash of the last frame presented
+    bool dirty;                         // Redraw the next frame no matter what
+    bool always;                        // Idle mode off : redraw every frame
+} Damage;
+
+void damage_init(Damage *damage)
+{
+    damage->hash = 0;
+    damage->dirty = true;
+    damage->always = (getenv("ALWAYS_REDRAW") != NULL);
+}
+
+void damage_mark(Damage *damage)
+{ // The window needs a redraw, e.g., it was exposed or resized, or a texture changed
+    damage->dirty = true;
+}
+
+uint64_t damage_hash(uint64_t h, const void *data, size_t len)
+{ // FNV-1a: hash len bytes into h
+    const uint8_t *p = data;
+    for( size_t i=0; i<len; i++ ) { h ^= p[i]; h *= 1099511628211ull; }
+    return h;
+}
+
+uint64_t damage_hash_anims(uint64_t h, const AnimSystem *anims, float alpha)
+{ // Hash what anims_draw() would draw
+    for( int i=0; i<anims->n; i++ )
+    {
+        const Sprite *sprite = anims->clips[anims->clip[i]];
+        SDL_Rect render = anims_render_rect(anims, i, alpha);
+        h = damage_hash(h, &sprite->tex, sizeof(sprite->tex));
+        h = damage_hash(h, anims_frame(anims, i), sizeof(SDL_Rect));
+        h = damage_hash(h, &render, sizeof(render));
+        h = damage_hash(h, &anims->dir[i], sizeof(int));
+    }
+    return h;
+}
+
+bool damage_changed(Damage *damage, uint64_t hash)
+{ // Return true if the frame must be drawn. Then it counts as presented.
+    bool changed = damage->always || damage->dirty || (hash != damage->hash);
+    damage->hash = hash;
+    damage->dirty = false;
+    return changed;
+}
+
+void damage_wait(const Pacing *pacing, int ticks, bool busy)
+{ // Nothing to draw: block until an event, or until the simulation has run ticks more ticks
+    /* *************DOC***************
+     * busy : something finishes in the background (a sheet loading,
+     *        a background resize) without sending an SDL event, so
+     *        only wait one video frame
+     * *******************************/
+    Uint32 ms = (ticks < PACING_SIM_HZ) ? pacing_ms_until(pacing, ticks) : DAMAGE_MAX_WAIT_MS;
+    if(  ms > DAMAGE_MAX_WAIT_MS  ) ms = DAMAGE_MAX_WAIT_MS;
+    if(  busy && (ms > (Uint32)(pacing->frame_time*1000))  ) ms = (Uint32)(pacing->frame_time*1000);
+    if(  ms > 0  ) SDL_WaitEventTimeout(NULL, (int)ms);
+}
+
+#endif // __DAMAGE_H__
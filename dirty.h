@@ -0,0 +1,153 @@
+#ifndef __DIRTY_H__
+#define __DIRTY_H__
+/* *************Dirty rectangles***************
+ * Redraw only the parts of the scene that changed.
+ *
+ * The scene is drawn into a target texture that is kept between
+ * frames. Each frame lists the rects it draws (each sprite's screen
+ * rect, the overlay). The regions to redraw are this frame's rects
+ * plus last frame's rects (where a sprite was, the background must
+ * come back). For each region: clip to it, draw the background,
+ * then whatever overlaps it. Everything else in the target is left
+ * from the last frame.
+ *
+ * Example:
+ *      DirtyRects dirty;
+ *      if(  dirty_init(&dirty, ren, wI.w, wI.h) < 0  ) ... // Renderer cannot: draw the whole frame
+ *      ...
+ *      dirty_add(&dirty, sprite_rect);                     // Every rect this frame draws
+ *      int n = dirty_begin(&dirty, ren);                   // Draw into the target
+ *      for( int i=0; i<n; i++ )
+ *      {
+ *          const SDL_Rect *clip = dirty_clip(&dirty, ren, i);
+ *          ... draw background, then what overlaps clip ...
+ *      }
+ *      dirty_end(&dirty, ren);                             // Copy the target to the window
+ *      SDL_RenderPresent(ren);
+ *
+ * The copy to the window is still the whole window (the window's
+ * back buffer is not kept after a present), but it is one opaque
+ * copy: the background gradient and the blending only run over the
+ * dirty regions.
+ *
+ * When the regions add up to more than half the window (or there
+ * are more than DIRTY_MAX_RECTS rects), the whole target is redrawn.
+ * *******************************/
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <SDL.h>
+
+#define DIRTY_MAX_RECTS 32              // Max rects drawn per frame, more : redraw everything
+#define DIRTY_PAD 1                     // Grow each rect by this much (rounding in scaled draws)
+
+typedef struct
+{
+    SDL_Texture *target;                // Scene kept between frames, NULL : dirty rects are off
+    int w, h;                           // Size of target
+    SDL_Rect cur[DIRTY_MAX_RECTS];      // Rects drawn this frame
+    int ncur;
+    SDL_Rect prev[DIRTY_MAX_RECTS];     // Rects drawn last frame
+    int nprev;
+    SDL_Rect rect[2*DIRTY_MAX_RECTS];   // Regions to redraw this frame
+    int n;
+    bool full;                          // Redraw the whole target
+} DirtyRects;
+
+int dirty_resize(DirtyRects *dirty, SDL_Renderer *ren, int w, int h)
+{ // Make a new w x h target, e.g., after a window resize. The next frame redraws everything.
+    SDL_DestroyTexture(dirty->target);
+    dirty->target = SDL_CreateTexture(ren, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, w, h);
+    if(  dirty->target == NULL  )
+    {
+        printf("Cannot create dirty rect target: %s\n", SDL_GetError());
+        return -1;
+    }
+    SDL_SetTextureBlendMode(dirty->target, SDL_BLENDMODE_NONE); // Copy to the window, no blend
+    dirty->w = w; dirty->h = h;
+    dirty->ncur = 0; dirty->nprev = 0;
+    dirty->full = true;
+    return 0;
+}
+
+int dirty_init(DirtyRects *dirty, SDL_Renderer *ren, int w, int h)
+{ // Return -1 if the renderer cannot draw into a texture (target is NULL, draw whole frames)
+    *dirty = (DirtyRects){0};
+    if(  SDL_RenderTargetSupported(ren) == SDL_FALSE  )
+    {
+        puts("Renderer cannot draw into a texture: no dirty rects");
+        return -1;
+    }
+    return dirty_resize(dirty, ren, w, h);
+}
+
+void dirty_full(DirtyRects *dirty)
+{ // Redraw the whole target next frame, e.g., a sprite sheet or the background changed
+    dirty->full = true;
+}
+
+void dirty_add(DirtyRects *dirty, SDL_Rect r)
+{ // This frame draws rect r
+    r.x -= DIRTY_PAD; r.y -= DIRTY_PAD; r.w += 2*DIRTY_PAD; r.h += 2*DIRTY_PAD;
+    SDL_Rect all = {.x=0, .y=0, .w=dirty->w, .h=dirty->h};
+    if(  SDL_IntersectRect(&r, &all, &r) == SDL_FALSE  ) return;   // Off screen
+    if(  dirty->ncur == DIRTY_MAX_RECTS  ) { dirty->full = true; return; }
+    dirty->cur[dirty->ncur++] = r;
+}
+
+void dirty_merge(DirtyRects *dirty, SDL_Rect r)
+{ // Add r to the regions. Overlapping regions become one (nothing is drawn twice).
+    for( int i=0; i<dirty->n; i++ )
+    {
+        if(  SDL_HasIntersection(&r, &dirty->rect[i]) == SDL_FALSE  ) continue;
+        SDL_UnionRect(&r, &dirty->rect[i], &r);
+        dirty->rect[i] = dirty->rect[--dirty->n];               // Take it out, merge the union again
+        i = -1;
+    }
+    dirty->rect[dirty->n++] = r;
+}
+
+int dirty_begin(DirtyRects *dirty, SDL_Renderer *ren)
+{ // Draw into the target. Return the number of regions to redraw (see dirty_clip).
+    SDL_SetRenderTarget(ren, dirty->target);
+    dirty->n = 0;
+    if(  dirty->full == false  )
+    {
+        for( int i=0; i<dirty->nprev; i++ ) dirty_merge(dirty, dirty->prev[i]);
+        for( int i=0; i<dirty->ncur; i++ )  dirty_merge(dirty, dirty->cur[i]);
+        long area = 0;
+        for( int i=0; i<dirty->n; i++ ) area += (long)dirty->rect[i].w*dirty->rect[i].h;
+        if(  2*area > (long)dirty->w*dirty->h  ) dirty->full = true;
+    }
+    if(  dirty->full  )
+    {
+        dirty->rect[0] = (SDL_Rect){.x=0, .y=0, .w=dirty->w, .h=dirty->h};
+        dirty->n = 1;
+        dirty->full = false;
+    }
+    memcpy(dirty->prev, dirty->cur, dirty->ncur*sizeof(SDL_Rect));
+    dirty->nprev = dirty->ncur;
+    dirty->ncur = 0;
+    return dirty->n;
+}
+
+const SDL_Rect *dirty_clip(DirtyRects *dirty, SDL_Renderer *ren, int i)
+{ // Clip drawing to region i and return it
+    SDL_RenderSetClipRect(ren, &dirty->rect[i]);
+    return &dirty->rect[i];
+}
+
+void dirty_end(DirtyRects *dirty, SDL_Renderer *ren)
+{ // Draw into the window again: copy the whole target
+    SDL_RenderSetClipRect(ren, NULL);
+    SDL_SetRenderTarget(ren, NULL);
+    SDL_RenderCopy(ren, dirty->target, NULL, NULL);
+}
+
+void dirty_free(DirtyRects *dirty)
+{
+    SDL_DestroyTexture(dirty->target);
+    dirty->target = NULL;
+}
+
+#endif // __DIRTY_H__
@@ -1,6 +1,9 @@
 #ifndef __FONT_H__
 #define __FONT_H__
 
+#include <SDL.h>
+#include <SDL_ttf.h>
+
 int font_init(void)
 {
     if(  TTF_Init() < 0  )
@@ -21,5 +24,174 @@ int font_load(TTF_Font **font_struct, const char *font_path, int ptsize)
     return 0;
 }
 
-#endif // __FONT_H__
+/* *************Glyph atlas***************
+ * Rasterize the printable ASCII glyphs once into a single texture.
+ * Draw a string as a batch of textured quads (one SDL_RenderGeometry
+ * call per FONT_ATLAS_BATCH glyphs) instead of TTF -> Surface -> Texture.
+ *
+ * Example:
+ *      GlyphAtlas atlas;
+ *      font_atlas_build(&atlas, ren, debug_font);
+ *      font_atlas_draw(&atlas, ren, "Hello", 5, 5, wI.w, (SDL_Color){255,255,255,255});
+ *      font_atlas_free(&atlas);
+ *
+ * Glyphs are white in the texture. The text color is a vertex color.
+ * *******************************/
+#define FONT_ATLAS_FIRST ' '                                    // First glyph in atlas
+#define FONT_ATLAS_LAST  '~'                                    // Last glyph in atlas
+#define FONT_ATLAS_NGLYPHS (FONT_ATLAS_LAST-FONT_ATLAS_FIRST+1)
+#define FONT_ATLAS_COLS 16                                      // Glyphs per row in atlas texture
+#define FONT_ATLAS_BATCH 128                                    // Max glyphs per draw call
+
+typedef struct
+{
+    SDL_Texture *tex;                   // All glyphs, white on transparent
+    int tex_w, tex_h;                   // Size of tex (for UVs)
+    SDL_Rect glyph[FONT_ATLAS_NGLYPHS]; // Glyph rect in tex
+    int advance[FONT_ATLAS_NGLYPHS];    // Pen advance after glyph
+    int line_skip;                      // Pen advance after newline
+} GlyphAtlas;
 
+int font_atlas_build(GlyphAtlas *atlas, SDL_Renderer *ren, TTF_Font *font)
+{ // Rasterize all glyphs into atlas->tex. Return -1 on error.
+    SDL_Color white = {255,255,255,255};
+    SDL_Surface *glyph_surf[FONT_ATLAS_NGLYPHS];
+    int cell_w = 1; int cell_h = TTF_FontHeight(font);
+    for( int i=0; i<FONT_ATLAS_NGLYPHS; i++ )
+    { // Rasterize each glyph and find the biggest cell
+        Uint16 ch = (Uint16)(FONT_ATLAS_FIRST + i);
+        glyph_surf[i] = TTF_RenderGlyph_Blended(font, ch, white);
+        if(  TTF_GlyphMetrics(font, ch, NULL, NULL, NULL, NULL, &atlas->advance[i]) < 0  )
+        {
+            atlas->advance[i] = (glyph_surf[i] != NULL) ? glyph_surf[i]->w : 0;
+        }
+        if(  glyph_surf[i] == NULL  ) continue;                 // e.g., ' ' has no pixels
+        if(  glyph_surf[i]->w > cell_w  ) cell_w = glyph_surf[i]->w;
+        if(  glyph_surf[i]->h > cell_h  ) cell_h = glyph_surf[i]->h;
+    }
+    atlas->line_skip = TTF_FontLineSkip(font);
+    int rows = (FONT_ATLAS_NGLYPHS + FONT_ATLAS_COLS - 1)/FONT_ATLAS_COLS;
+    atlas->tex_w = FONT_ATLAS_COLS*cell_w;
+    atlas->tex_h = rows*cell_h;
+    SDL_Surface *surf = SDL_CreateRGBSurfaceWithFormat(0, atlas->tex_w, atlas->tex_h,
+                                                       32, SDL_PIXELFORMAT_ARGB8888);
+    for( int i=0; i<FONT_ATLAS_NGLYPHS; i++ )
+    { // Copy each glyph (with its alpha) into its cell
+        SDL_Rect *g = &atlas->glyph[i];
+        g->x = (i%FONT_ATLAS_COLS)*cell_w; g->y = (i/FONT_ATLAS_COLS)*cell_h;
+        g->w = 0; g->h = 0;
+        if(  glyph_surf[i] == NULL  ) continue;
+        g->w = glyph_surf[i]->w; g->h = glyph_surf[i]->h;
+        if(  surf != NULL  )
+        {
+            SDL_SetSurfaceBlendMode(glyph_surf[i], SDL_BLENDMODE_NONE);
+            SDL_BlitSurface(glyph_surf[i], NULL, surf, g);
+        }
+        SDL_FreeSurface(glyph_surf[i]);
+    }
+    if(  surf == NULL  )
+    { // Error handling: out of memory
+        printf("Cannot create glyph atlas surface: %s\n", SDL_GetError());
+        atlas->tex = NULL;
+        return -1;
+    }
+    atlas->tex = SDL_CreateTextureFromSurface(ren, surf);
+    SDL_FreeSurface(surf);
+    if(  atlas->tex == NULL  )
+    {
+        printf("Cannot create glyph atlas texture: %s\n", SDL_GetError());
+        return -1;
+    }
+    SDL_SetTextureBlendMode(atlas->tex, SDL_BLENDMODE_BLEND);
+    return 0;
+}
+
+void font_atlas_free(GlyphAtlas *atlas)
+{
+    SDL_DestroyTexture(atlas->tex);
+    atlas->tex = NULL;
+}
+
+int font_atlas_glyph_index(char c)
+{ // Return index into atlas tables. Characters outside the atlas draw as '?'
+    if(  (c < FONT_ATLAS_FIRST) || (c > FONT_ATLAS_LAST)  ) c = '?';
+    return c - FONT_ATLAS_FIRST;
+}
+
+int font_atlas_word_width(const GlyphAtlas *atlas, const char *c)
+{ // Return width of the word starting at c (ends at space, newline, or nul)
+    int w = 0;
+    while(  (*c != '\0') && (*c != ' ') && (*c != '\n')  )
+    {
+        w += atlas->advance[font_atlas_glyph_index(*c++)];
+    }
+    return w;
+}
+
+void font_atlas_layout(const GlyphAtlas *atlas, SDL_Renderer *ren, const char *text,
+                       int x, int y, int wrap, SDL_Color fg, int *w, int *h)
+{ // Walk text, word-wrapping at wrap pixels. Draw if ren is not NULL. Return extent in w, h.
+    /* *************DOC***************
+     * Same wrapping rule as TTF_RenderText_Blended_Wrapped:
+     * break on '\n', and break before a word that would cross wrap.
+     * *******************************/
+    SDL_Vertex v[4*FONT_ATLAS_BATCH];
+    int idx[6*FONT_ATLAS_BATCH];
+    int n = 0;                                                  // Glyphs in batch
+    float u = 1.0f/(float)atlas->tex_w; float t = 1.0f/(float)atlas->tex_h;
+    int pen_x = 0; int pen_y = 0; int max_x = 0;
+    for( const char *c = text; *c != '\0'; c++ )
+    {
+        if(  *c == '\n'  )
+        {
+            pen_x = 0; pen_y += atlas->line_skip;
+            continue;
+        }
+        if(  (pen_x > 0) && (*c != ' ') && ((c == text) || (c[-1] == ' '))  )
+        { // Start of a word: wrap if it does not fit on this line
+            if(  pen_x + font_atlas_word_width(atlas, c) > wrap  )
+            {
+                pen_x = 0; pen_y += atlas->line_skip;
+            }
+        }
+        int i = font_atlas_glyph_index(*c);
+        const SDL_Rect *g = &atlas->glyph[i];
+        if(  (ren != NULL) && (g->w > 0)  )
+        { // Queue a quad for this glyph
+            float x0 = (float)(x + pen_x); float y0 = (float)(y + pen_y);
+            float x1 = x0 + (float)g->w;   float y1 = y0 + (float)g->h;
+            float u0 = g->x*u; float v0 = g->y*t;
+            float u1 = (g->x+g->w)*u; float v1 = (g->y+g->h)*t;
+            SDL_Vertex *q = &v[4*n];
+            q[0] = (SDL_Vertex){{x0,y0}, fg, {u0,v0}};
+            q[1] = (SDL_Vertex){{x1,y0}, fg, {u1,v0}};
+            q[2] = (SDL_Vertex){{x1,y1}, fg, {u1,v1}};
+            q[3] = (SDL_Vertex){{x0,y1}, fg, {u0,v1}};
+            int *k = &idx[6*n]; int b = 4*n;
+            k[0]=b; k[1]=b+1; k[2]=b+2; k[3]=b; k[4]=b+2; k[5]=b+3;
+            if(  ++n == FONT_ATLAS_BATCH  )
+            { // Batch is full
+                SDL_RenderGeometry(ren, atlas->tex, v, 4*n, idx, 6*n);
+                n = 0;
+            }
+        }
+        pen_x += atlas->advance[i];
+        if(  pen_x > max_x  ) max_x = pen_x;
+    }
+    if(  (ren != NULL) && (n > 0)  ) SDL_RenderGeometry(ren, atlas->tex, v, 4*n, idx, 6*n);
+    if(  w != NULL  ) *w = max_x;
+    if(  h != NULL  ) *h = pen_y + atlas->line_skip;
+}
+
+void font_atlas_measure(const GlyphAtlas *atlas, const char *text, int wrap, int *w, int *h)
+{ // Size of text in pixels when wrapped at wrap pixels
+    font_atlas_layout(atlas, NULL, text, 0, 0, wrap, (SDL_Color){0}, w, h);
+}
+
+void font_atlas_draw(const GlyphAtlas *atlas, SDL_Renderer *ren, const char *text,
+                     int x, int y, int wrap, SDL_Color fg)
+{ // Draw text with top-left corner at x,y
+    font_atlas_layout(atlas, ren, text, x, y, wrap, fg, NULL, NULL);
+}
+
+#endif // __FONT_H__
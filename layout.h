@@ -0,0 +1,359 @@
+#ifndef __LAYOUT_H__
+#define __LAYOUT_H__
+/* *************Sprite sheet layout***************
+ * Where the frames are in a sprite sheet.
+ *
+ * Default (no descriptor): 8 columns of square frames, frame size is
+ * sheet width / 8, frames run in reading order up to the first empty
+ * cell. That is how Pixaki exports.
+ *
+ * A descriptor next to the png overrides the default:
+ *
+ *      art/penguin-huff.png
+ *      art/penguin-huff.layout     sidecar, see below
+ *      art/penguin-huff.json       Aseprite or TexturePacker JSON
+ *
+ * Sidecar: one "key = value" per line, # starts a comment. Every key
+ * is optional. frame_w and frame_h must be > 0, the others >= 0. A
+ * line that is not blank, a comment, or "key = value" makes the whole
+ * sidecar bad.
+ *
+ *      frame_w = 48                # Frame size in pixels
+ *      frame_h = 64
+ *      cols = 5                    # Grid size (default: as many as fit)
+ *      rows = 2
+ *      margin = 1                  # Pixels around the grid
+ *      spacing = 2                 # Pixels between cells
+ *      frames = 9                  # Frame count (default: up to the first empty cell)
+ *      duration = 100              # Milliseconds per frame
+ *      durations = 100,100,250     # Milliseconds for frame 1, 2, 3, ...
+ *
+ * JSON: the "frames" hash or array as exported by Aseprite ("Export
+ * Sprite Sheet", JSON Data) or TexturePacker. Each frame's "frame"
+ * rect and optional "duration" (ms) are read, in file order. If the
+ * tool trimmed the frame, "spriteSourceSize" (where the rect sits in
+ * the untrimmed frame) and "sourceSize" (untrimmed size) are read
+ * too. Everything else is skipped.
+ *
+ * Example:
+ *      SpriteLayout layout;
+ *      if(  layout_load(&layout, "art/penguin-huff.png") < 0  ) ... // Bad descriptor: default used
+ * *******************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <SDL.h>
+
+#define LAYOUT_MAX_FRAMES 256           // Max frames in one sheet
+#define LAYOUT_MAX_FILE (1 << 20)       // Max descriptor size in bytes
+#define LAYOUT_DEFAULT_COLS 8           // Default grid: 8 columns of square frames
+
+typedef struct
+{
+    int frame_w, frame_h;               // 0 : sheet width / LAYOUT_DEFAULT_COLS, square
+    int cols, rows;                     // 0 : as many as fit in the sheet
+    int margin;                         // Pixels from the sheet edge to the first cell
+    int spacing;                        // Pixels between cells
+    int nframes;                        // 0 : frames up to the first empty cell
+    int duration_ms;                    // Every frame, 0 : use the sprite's ticks_per_frame
+    int nrects;                         // > 0 : frames are rect[] (not a grid)
+    SDL_Rect rect[LAYOUT_MAX_FRAMES];
+    SDL_Rect source[LAYOUT_MAX_FRAMES]; // Untrimmed frame: x,y of rect[] in it, w,h its size (0 : rect[] is untrimmed)
+    int ms[LAYOUT_MAX_FRAMES];          // Per-frame duration, 0 : duration_ms
+} SpriteLayout;
+
+void layout_default(SpriteLayout *layout)
+{
+    memset(layout, 0, sizeof(*layout));
+}
+
+char *layout_read_file(const char *path, bool *bad)
+{ // Return the whole file, nul-terminated (free it), or NULL if missing or bad (*bad : too big or unreadable)
+    *bad = false;
+    FILE *f = fopen(path, "rb");
+    if(  f == NULL  ) return NULL;
+    long len = (fseek(f, 0, SEEK_END) == 0) ? ftell(f) : -1;
+    if(  (len < 0) || (len > LAYOUT_MAX_FILE) || (fseek(f, 0, SEEK_SET) != 0)  )
+    {
+        if(  len > LAYOUT_MAX_FILE  ) printf("\"%s\" is bigger than %d bytes\n", path, LAYOUT_MAX_FILE);
+        else printf("Cannot read \"%s\"\n", path);
+        fclose(f); *bad = true;
+        return NULL;
+    }
+    char *buf = malloc((size_t)len + 1);
+    size_t got = (buf != NULL) ? fread(buf, 1, (size_t)len, f) : 0;
+    fclose(f);
+    if(  (buf == NULL) || (got != (size_t)len)  )
+    {
+        if(  buf == NULL  ) printf("Out of memory reading \"%s\"\n", path);
+        else printf("Cannot read \"%s\"\n", path);
+        free(buf); *bad = true;
+        return NULL;
+    }
+    buf[len] = '\0';
+    return buf;
+}
+
+bool layout_line_done(const char *c, const char *end)
+{ // Only blanks or a comment from c to the end of the line
+    while(  (c < end) && ((*c == ' ') || (*c == '\t') || (*c == '\r'))  ) c++;
+    return (c == end) || (*c == '#');
+}
+
+int layout_parse_sidecar(SpriteLayout *layout, const char *text)
+{ // Parse "key = value" lines. Return -1 on a bad line, an unknown key or a bad value.
+    const char *line = text;
+    while(  *line != '\0'  )
+    {
+        const char *end = strchr(line, '\n');
+        if(  end == NULL  ) end = line + strlen(line);
+        char key[32]; int val = 0; int used = 0;
+        if(  layout_line_done(line, end)  ) { line = (*end == '\n') ? end+1 : end; continue; } // Blank or comment
+        if(  (sscanf(line, " %31[a-z_] = %d%n", key, &val, &used) != 2) || (line + used > end)  )
+        {
+            printf("Cannot parse layout line \"%.*s\"\n", (int)(end - line), line);
+            return -1;
+        }
+        if(       strcmp(key, "frame_w") == 0  ) layout->frame_w = val;
+        else if(  strcmp(key, "frame_h") == 0  ) layout->frame_h = val;
+        else if(  strcmp(key, "cols") == 0  )    layout->cols = val;
+        else if(  strcmp(key, "rows") == 0  )    layout->rows = val;
+        else if(  strcmp(key, "margin") == 0  )  layout->margin = val;
+        else if(  strcmp(key, "spacing") == 0  ) layout->spacing = val;
+        else if(  strcmp(key, "frames") == 0  )  layout->nframes = val;
+        else if(  strcmp(key, "duration") == 0  ) layout->duration_ms = val;
+        else if(  strcmp(key, "durations") == 0  )
+        { // Comma-separated list
+            const char *c = line + used;
+            layout->ms[0] = val;
+            for( int f=1; (f<LAYOUT_MAX_FRAMES) && (*c == ','); f++ )
+            {
+                char *next;
+                long ms = strtol(c+1, &next, 10);
+                if(  (next == c+1) || (next > end) || (ms < 0) || (ms > INT_MAX)  )
+                {
+                    printf("Bad duration %d in layout line \"%.*s\"\n", f+1, (int)(end - line), line);
+                    return -1;
+                }
+                layout->ms[f] = (int)ms;
+                c = next;
+            }
+            used = (int)(c - line);
+        }
+        else
+        {
+            printf("Unknown layout key \"%s\"\n", key);
+            return -1;
+        }
+        bool size = (strcmp(key, "frame_w") == 0) || (strcmp(key, "frame_h") == 0);
+        if(  (size && (val <= 0)) || (val < 0)  )
+        { // Zero or negative cell step, or cells outside the sheet
+            printf("Layout key \"%s\" cannot be %d\n", key, val);
+            return -1;
+        }
+        if(  layout_line_done(line + used, end) == false  )
+        { // e.g., "frame_w = 48px" or more durations than LAYOUT_MAX_FRAMES
+            printf("Cannot parse layout line \"%.*s\"\n", (int)(end - line), line);
+            return -1;
+        }
+        line = (*end == '\n') ? end+1 : end;
+    }
+    return 0;
+}
+
+/* *************JSON***************
+ * Just enough JSON to walk an Aseprite/TexturePacker file in one
+ * pass, without allocating: skip whitespace, read a string key, read
+ * a number, skip any value. Each function returns a pointer past
+ * what it read, or NULL on a syntax error.
+ * *******************************/
+const char *layout_json_ws(const char *p)
+{
+    while(  (*p == ' ') || (*p == '\t') || (*p == '\n') || (*p == '\r')  ) p++;
+    return p;
+}
+
+const char *layout_json_string(const char *p, char *out, int len)
+{ // Read a string into out (truncated to len-1 characters, escapes kept as-is)
+    if(  *p != '"'  ) return NULL;
+    p++;
+    int n = 0;
+    while(  (*p != '"') && (*p != '\0')  )
+    {
+        if(  (*p == '\\') && (p[1] != '\0')  ) { if( n < len-1 ) out[n++] = *p; p++; }
+        if(  n < len-1  ) out[n++] = *p;
+        p++;
+    }
+    out[n] = '\0';
+    return (*p == '"') ? p+1 : NULL;
+}
+
+const char *layout_json_skip(const char *p)
+{ // Skip one value of any type
+    p = layout_json_ws(p);
+    if(  *p == '"'  )
+    {
+        for( p++; (*p != '"') && (*p != '\0'); p++ ) if( (*p == '\\') && (p[1] != '\0') ) p++;
+        return (*p == '"') ? p+1 : NULL;
+    }
+    if(  (*p == '{') || (*p == '[')  )
+    { // Count brackets, skipping strings
+        int depth = 0;
+        do
+        {
+            if(  (*p == '{') || (*p == '[')  ) depth++;
+            else if(  (*p == '}') || (*p == ']')  ) depth--;
+            else if(  *p == '"'  ) { p = layout_json_skip(p); if( p == NULL ) return NULL; continue; }
+            else if(  *p == '\0'  ) return NULL;
+            p++;
+        } while(  depth > 0  );
+        return p;
+    }
+    const char *start = p;                                      // Number, true, false, null
+    while(  (*p != ',') && (*p != '}') && (*p != ']') && (*p != '\0') && (*p > ' ')  ) p++;
+    return (p > start) ? p : NULL;
+}
+
+const char *layout_json_member(const char *p, char *key, int len)
+{ // At '{' or ',': read the next "key": and stop at its value. Return NULL at '}'.
+    p = layout_json_ws(p);
+    if(  (*p != '{') && (*p != ',')  ) return NULL;
+    p = layout_json_ws(p+1);
+    if(  *p == '}'  ) return NULL;
+    p = layout_json_string(p, key, len);
+    if(  p == NULL  ) return NULL;
+    p = layout_json_ws(p);
+    return (*p == ':') ? layout_json_ws(p+1) : NULL;
+}
+
+const char *layout_json_end(const char *p, char close)
+{ // After a value: return p at ',' (more to come) or at close (done), else NULL
+    p = layout_json_ws(p);
+    return ((*p == ',') || (*p == close)) ? p : NULL;
+}
+
+const char *layout_json_rect(const char *p, SDL_Rect *rect)
+{ // Read {"x":..,"y":..,"w":..,"h":..} (missing keys are not changed)
+    char key[8];
+    const char *v;
+    while(  (v = layout_json_member(p, key, sizeof(key))) != NULL  )
+    {
+        int val = (int)strtol(v, NULL, 10);
+        if(       strcmp(key, "x") == 0  ) rect->x = val;
+        else if(  strcmp(key, "y") == 0  ) rect->y = val;
+        else if(  strcmp(key, "w") == 0  ) rect->w = val;
+        else if(  strcmp(key, "h") == 0  ) rect->h = val;
+        p = layout_json_skip(v);
+        if(  (p == NULL) || ((p = layout_json_end(p, '}')) == NULL)  ) return NULL;
+    }
+    p = layout_json_ws(p);
+    return (*p == '}') ? p+1 : NULL;
+}
+
+const char *layout_json_frame(const char *p, SpriteLayout *layout)
+{ // Read one frame object into the next rect
+    if(  layout->nrects == LAYOUT_MAX_FRAMES  ) return layout_json_skip(p);
+    int f = layout->nrects++;
+    char key[32];
+    const char *v;
+    while(  (v = layout_json_member(p, key, sizeof(key))) != NULL  )
+    {
+        if(       strcmp(key, "frame") == 0  )    p = layout_json_rect(v, &layout->rect[f]);
+        else if(  strcmp(key, "spriteSourceSize") == 0  )
+        { // Only x,y: w,h are the trimmed size again
+            SDL_Rect r = {0};
+            p = layout_json_rect(v, &r);
+            layout->source[f].x = r.x; layout->source[f].y = r.y;
+        }
+        else if(  strcmp(key, "sourceSize") == 0  )
+        {
+            SDL_Rect r = {0};
+            p = layout_json_rect(v, &r);
+            layout->source[f].w = r.w; layout->source[f].h = r.h;
+        }
+        else if(  strcmp(key, "duration") == 0  ) { layout->ms[f] = (int)strtol(v, NULL, 10); p = layout_json_skip(v); }
+        else p = layout_json_skip(v);
+        if(  (p == NULL) || ((p = layout_json_end(p, '}')) == NULL)  ) return NULL;
+    }
+    p = layout_json_ws(p);
+    return (*p == '}') ? p+1 : NULL;
+}
+
+int layout_parse_json(SpriteLayout *layout, const char *text)
+{ // Read the "frames" hash or array. Return -1 on a syntax error or if there are no frames.
+    char key[64];
+    const char *p = layout_json_ws(text);
+    const char *v;
+    while(  (v = layout_json_member(p, key, sizeof(key))) != NULL  )
+    {
+        if(  strcmp(key, "frames") == 0  )
+        {
+            if(  *v == '['  )
+            { // Array of frames
+                p = layout_json_ws(v+1);
+                while(  (p != NULL) && (*p == '{')  )
+                {
+                    p = layout_json_frame(p, layout);
+                    if(  (p == NULL) || ((p = layout_json_end(p, ']')) == NULL)  ) return -1;
+                    if(  *p == ','  ) p = layout_json_ws(p+1);
+                }
+                if(  (p == NULL) || (*p != ']')  ) return -1;
+                p++;
+            }
+            else
+            { // Hash of frames: "name": {frame}, in file order
+                char name[8];
+                const char *fv;
+                p = v;
+                while(  (fv = layout_json_member(p, name, sizeof(name))) != NULL  )
+                {
+                    p = layout_json_frame(fv, layout);
+                    if(  (p == NULL) || ((p = layout_json_end(p, '}')) == NULL)  ) return -1;
+                }
+                p = layout_json_ws(p);
+                if(  *p != '}'  ) return -1;
+                p++;
+            }
+        }
+        else p = layout_json_skip(v);
+        if(  (p == NULL) || ((p = layout_json_end(p, '}')) == NULL)  ) return -1;
+    }
+    return (layout->nrects > 0) ? 0 : -1;
+}
+
+#define LAYOUT_NEXT 2
+const char *const layout_ext[LAYOUT_NEXT] = {"layout", "json"}; // Descriptor extensions, first found wins
+
+void layout_path(char *path, int len, const char *png_path, const char *ext)
+{ // "art/foo.png" -> "art/foo.<ext>"
+    const char *dot = strrchr(png_path, '.');
+    int stem = (dot != NULL) ? (int)(dot - png_path) : (int)strlen(png_path);
+    snprintf(path, len, "%.*s.%s", stem, png_path, ext);
+}
+
+int layout_load(SpriteLayout *layout, const char *png_path)
+{ // Load the descriptor next to png_path. Return 1 if found, 0 if none (default layout), -1 if bad (default layout).
+    layout_default(layout);
+    char path[256];
+    for( int e=0; e<LAYOUT_NEXT; e++ )
+    {
+        layout_path(path, sizeof(path), png_path, layout_ext[e]);
+        bool bad;
+        char *text = layout_read_file(path, &bad);
+        if(  (text == NULL) && (bad == false)  ) continue;
+        int ret = (text == NULL) ? -1 : (e == 0) ? layout_parse_sidecar(layout, text) : layout_parse_json(layout, text);
+        free(text);
+        if(  ret < 0  )
+        {
+            printf("Bad layout \"%s\". Using the default layout.\n", path);
+            layout_default(layout);
+            return -1;
+        }
+        return 1;
+    }
+    return 0;
+}
+
+#endif // __LAYOUT_H__
@@ -1,13 +1,14 @@
 /* *************Sprite Sheet: Overview***************
- * - Load sprite sheet png as SDL texture tex_PI
- *   (tex_PI has all frames)
+ * - Load sprite sheet png as SDL texture sprite_PI->tex
+ *   (sprite_PI->tex has all frames)
+ *   (png is decoded once, on a worker thread: see assets.h)
  *   (PI stands for Penguin Idle)
  * - Animate by moving the frame rectangle around the spritesheet texture
  * - Copy rectangular section of texture to the renderer
  * - Renderer rectangle sets the size and location on the screen
  *
  *   Example:
- *   SDL_RenderCopy(ren, tex_PI, &sprite_PI->frame, &sprite_PI->render);
+ *   SDL_RenderCopy(ren, sprite_PI->tex, &sprite_PI->frame, &sprite_PI->render);
  *
  *   Rects:
  *   sprite_PI->frame : SDL_Rect identify one frame on the sprite sheet
@@ -15,10 +16,10 @@
  *   frame on screen
  * *******************************/
 /* *************Sprite Sheet: Select Frames***************
- * - Every frame has size sprite_PI->size x sprite_PI->size
- * - Example: rect selects the first frame (x=0, y=0)
+ * - Frame n is sprite_PI->frame_rect[n-1] (grid or explicit rects, see layout.h)
+ * - Example: rect selects the first frame of the default layout (x=0, y=0)
  *
- *      SDL_Rect sprite_PI->frame = {.x=0, .y=0, .w=sprite_PI->size, .h=sprite_PI->size};
+ *      SDL_Rect sprite_PI->frame = {.x=0, .y=0, .w=sprite_PI->frame_w, .h=sprite_PI->frame_h};
  *
  * - Define the size and location of the sprite frame on the screen.
  * - Example: rect centers the sprite on the screen and renders it to scale
@@ -45,22 +46,35 @@
 #include "text.h"
 #include "window_info.h"
 #include "bgnd.h"
-#include "print.h"
 #include "anim.h"
 #include "font.h"
 #include "sprite.h"
+#include "atlas.h"
+#include "bake.h"
+#include "batch.h"
+#include "anims.h"
+#include "pacing.h"
+#include "prof.h"
+#include "overlay.h"
+#include "assets.h"
+#include "watch.h"
+#include "damage.h"
+#include "dirty.h"
+#include "record.h"
+#include "sim.h"
+#include "collide.h"
 
 void shutdown(TTF_Font *debug_font,
               SDL_Renderer *ren,
               SDL_Window *win,
               SDL_Texture *bgnd_tex,
-              SDL_Texture *tex_PI,
-              SDL_Texture *tex_PW)
+              Sprite *sprite_PI,
+              Sprite *sprite_PW)
 {
     IMG_Quit();
     SDL_DestroyTexture(bgnd_tex);
-    SDL_DestroyTexture(tex_PI);
-    SDL_DestroyTexture(tex_PW);
+    sprite_free(sprite_PI);
+    sprite_free(sprite_PW);
     SDL_DestroyRenderer(ren);
     SDL_DestroyWindow(win);
     TTF_CloseFont(debug_font);
@@ -68,16 +82,12 @@ void shutdown(TTF_Font *debug_font,
     SDL_Quit();
 }
 
-typedef struct
-{
-    int x;
-    int y;
-} Character;
-
-void center_char_on_screen(Character *character, int size, WindowInfo wI)
-{ // Center sprite on the screen
-    character->x=(wI.w-size)/2;
-    character->y=(wI.h-size)/2;
+void center_char_on_screen(Sim *sim, int i, WindowInfo wI)
+{ // Center sprite (its whole frame, scaled) on the screen
+    const AnimSystem *anims = sim->view;
+    const Sprite *sprite = anims->clips[anims->clip[i]];
+    int w = anims->scale[i]*sprite->frame_w; int h = anims->scale[i]*sprite->frame_h;
+    sim_send(sim, (SimCmd){.type=SIM_PLACE, .i=i, .x=(wI.w-w)/2, .y=(wI.h-h)/2});
 }
 
 int main(int argc, char *argv[])
@@ -106,12 +116,21 @@ int main(int argc, char *argv[])
     WindowInfo wI; WindowInfo_setup(&wI, argc, argv);                   // Size and locate window
     SDL_Window *win = SDL_CreateWindow(argv[0], wI.x, wI.y, wI.w, wI.h, wI.flags);
     SDL_Renderer *ren = SDL_CreateRenderer(win, -1, 0);
+    Record rec;                                                         // Record or replay the input
+    if(  record_init(&rec, win, &wI) < 0  )
+    {
+        shutdown(debug_font, ren, win, NULL, NULL, NULL); return EXIT_FAILURE;
+    }
     if(  SDL_SetRenderDrawBlendMode(ren, SDL_BLENDMODE_BLEND) < 0  )    // Draw with alpha
     {
         puts("Cannot draw with alpha channel");
         shutdown(debug_font, ren, win, NULL, NULL, NULL); return EXIT_FAILURE;
     }
 
+    // Rasterize the debug overlay font once
+    GlyphAtlas debug_atlas;
+    bool use_atlas = (font_atlas_build(&debug_atlas, ren, debug_font) == 0);
+
     // Load the spritesheets
     IMG_Init(IMG_INIT_PNG);                                     // Spritesheet is a PNG
 
@@ -119,66 +138,67 @@ int main(int argc, char *argv[])
     Sprite PenguinWalk = {.path = "art/penguin-waddle.png"};
 
     Sprite *sprite_PI = &PenguinIdle;                           // _PI : Penguin Idle
-    if(  sprite_load_info(sprite_PI) < 0  )
-    {
-        shutdown(debug_font, ren, win, NULL, NULL, NULL);
-        return EXIT_FAILURE;
-    }
-
     Sprite *sprite_PW = &PenguinWalk;                           // _PW : Penguin Walk
-    if(  sprite_load_info(sprite_PW) < 0  )
-    {
-        shutdown(debug_font, ren, win, NULL, NULL, NULL);
-        return EXIT_FAILURE;
+    Sprite *sprites[] = {sprite_PI, sprite_PW};
+    #define NSPRITES (int)(sizeof(sprites)/sizeof(sprites[0]))
+    Atlas atlas; atlas_init(&atlas, 0, 0);                      // One texture for all sheets
+    static AssetManager assets; assets_init(&assets);           // Decode sheets on worker threads
+    bool baked = (bake_load(&atlas, ren, "art.atlas", sprites, NSPRITES) == 0);
+    if(  baked == false  )
+    { // No baked atlas: decode and analyze each sheet in the background, upload when ready
+        assets.keep_surfaces = true;                            // Pack an atlas once all are ready
+        for( int i=0; i<NSPRITES; i++ ) assets_load(&assets, sprites[i]);
     }
+    else for( int i=0; i<NSPRITES; i++ ) assets_adopt(&assets, sprites[i]); // To reload on change
+    Watch watch; watch_init(&watch, "art");                     // Reload a sheet when its png changes
     sprite_PW->ticks_per_frame = 8;
 
-    Character char_penguin = {.x=0, .y=0};
-    center_char_on_screen(&char_penguin, sprite_PI->scale*sprite_PI->size, wI);
-
-    SDL_Texture *tex_PI;                                       // One texture for entire sprite sheet
-    { // Load Texture directly from spritesheet file
-        tex_PI = IMG_LoadTexture(ren, sprite_PI->path);
-        if(  tex_PI == NULL  )
-        {
-            printf("Failed to load \"%s\": %s", sprite_PI->path, IMG_GetError());
-            SDL_DestroyWindow(win); SDL_DestroyRenderer(ren);
-            TTF_CloseFont(debug_font); TTF_Quit(); SDL_Quit();
-            return EXIT_FAILURE;
-        }
-    }
-    SDL_Texture *tex_PW;                                       // One texture for entire sprite sheet
-    { // Load Texture directly from spritesheet file
-        tex_PW = IMG_LoadTexture(ren, sprite_PW->path);
-        if(  tex_PW == NULL  )
-        {
-            printf("Failed to load \"%s\": %s", sprite_PW->path, IMG_GetError());
-            SDL_DestroyWindow(win); SDL_DestroyRenderer(ren);
-            TTF_CloseFont(debug_font); TTF_Quit(); SDL_Quit();
-            return EXIT_FAILURE;
-        }
+    AnimSystem anims;                                           // Animation state of every character
+    if(  anims_init(&anims, 16) < 0  )
+    {
+        puts("Cannot allocate animation system");
+        watch_free(&watch);
+        assets_free(&assets);
+        atlas_free(&atlas);
+        shutdown(debug_font, ren, win, NULL, sprite_PI, sprite_PW);
+        return EXIT_FAILURE;
     }
+    int clip_PI = anims_add_clip(&anims, sprite_PI);            // Clips share the sprite sheets
+    int clip_PW = anims_add_clip(&anims, sprite_PW);
+    int penguin = anims_add(&anims, clip_PI, 0, 0);             // The penguin is instance 0
+    Sim sim; sim_init(&sim, &anims);                            // Animate here, or on a thread (sim_start)
+    center_char_on_screen(&sim, penguin, wI);
 
     // Create a background texture with a sky-colored gradient
-    SDL_Texture *bgnd_tex;
-    bgnd_gradient(&bgnd_tex, ren, wI);
+    SDL_Texture *bgnd_tex = NULL;
+    bool bgnd_quad = (getenv("BGND_TEXTURE") == NULL);          // Draw the gradient as one quad, no texture
+    if(  bgnd_quad == false  ) bgnd_gradient(&bgnd_tex, ren, wI);
+    BgndJob bgnd_job; bgnd_job_init(&bgnd_job);                 // Remake the texture on resize
 
 
+    SpriteBatch batch; batch_init(&batch);                      // Draw sprites in one call per texture
+    DirtyRects dirty = {0};                                     // Off : redraw the whole window
+    if(  getenv("DIRTY_RECTS") != NULL  ) dirty_init(&dirty, ren, wI.w, wI.h); // Redraw only what changed
+
     // Game state
     bool quit = false;
+    int exit_code = EXIT_SUCCESS;
+    bool penguin_placed = baked;                                // Centered once its sheet is loaded
     bool show_debug = true;
     bool walk_animation = false;
     int walk_direction = 1;
-    int ticks = 0;                                              // Count SDL ticks
+    float drawn_alpha = 0;                                      // alpha of the last frame drawn (hit-test clicks on it)
+    int clicked = -1;                                           // Character under the last click, -1 : none
 
     // Debug input
     #define DEBUG_INPUT_LEN 20
     char debug_input_buffer[DEBUG_INPUT_LEN];
-    char *debug_input_buffer_end = debug_input_buffer + DEBUG_INPUT_LEN*sizeof(char);
+    char *debug_input_buffer_end = debug_input_buffer + DEBUG_INPUT_LEN - 1;     // Room for '\0'
     char *debug_input = debug_input_buffer; *debug_input = '\0';
 
     TextBox tb;                                                 // Debug overlay text box
-    char text_buffer[1024];                                     // Max 1024 characters
+    char text_buffer[1024];                                     // Max 1023 characters
+    Overlay overlay; overlay_init(&overlay, text_buffer, sizeof(text_buffer));
     { // Set up the text box
         tb.margin = 5;                                          // Margin relative to window
         tb.fg = (SDL_Color){255,255,255,255};                   // Text color: white
@@ -189,45 +209,77 @@ int main(int argc, char *argv[])
         tb.bg_rect=(SDL_Rect){0};                               // Init bgnd size
         tb.bg_rect.w = wI.w;                                    // Bgnd is full window width
         tb.text = text_buffer;                                  // Point at text buffer
+        tb.tex = NULL;                                          // Rasterize on first draw
+        tb.hash = 0;
+        tb.atlas = use_atlas ? &debug_atlas : NULL;             // Fall back to TTF per change
+        tb.wrap = 0;
+    }
+    Pacing pacing; pacing_init(&pacing, win, ren);              // Fixed-timestep game loop
+    static Profiler prof; prof_init(&prof);                     // Time each stage of the loop
+    Damage damage; damage_init(&damage);                        // Skip frames that look like the last one
+    if(  rec.mode == RECORD_REPLAY  ) damage.always = true;     // Same work every replay
+    if(  (record_active(&rec) == false) && (getenv("SINGLE_THREAD") == NULL) && (SDL_GetCPUCount() > 1)  )
+    { // Simulate on a thread of its own (record and replay need the ticks in step with the frames)
+        sim_start(&sim);
     }
     while(  quit == false  )
     {
-        // Penguin position
-        sprite_PW->render.x = char_penguin.x;
-        sprite_PI->render.x = char_penguin.x;
-        sprite_PW->render.y = char_penguin.y;
-        sprite_PI->render.y = char_penguin.y;
+        pacing_begin_frame(&pacing);                            // Real time to simulate
+        prof_begin_frame(&prof);
+        if(  record_active(&rec) == false  ) watch_poll(&watch, &assets); // Queue changed sheets
+        for( int id; (id = assets_poll(&assets, ren)) >= 0; )
+        { // A sprite sheet finished (re)loading: upload is done, characters playing it can animate
+            Sprite *sprite = assets.asset[id].sprite;
+            if(  assets_state(&assets, id) == ASSET_FAILED  )
+            { // Same as a failed load before the game loop
+                quit = true; exit_code = EXIT_FAILURE;
+                continue;
+            }
+            sim_sprite_changed(&sim, sprite);
+            damage_mark(&damage);
+            if(  (sprite == sprite_PI) && (penguin_placed == false)  )
+            {
+                center_char_on_screen(&sim, penguin, wI);
+                penguin_placed = true;
+            }
+            if(  assets.keep_surfaces && (assets_pending(&assets) == 0)  ) assets_pack_atlas(&assets, &atlas, ren);
+        }
+        if(  record_active(&rec) && (assets_pending(&assets) > 0)  )
+        { // Record and replay start with every sheet loaded (load times differ from run to run)
+            pacing.accum = 0;
+            prof_cancel_frame(&prof);
+            SDL_Delay(1);
+            continue;
+        }
+        if(  record_begin_frame(&rec, &prof) == false  ) break;  // End of the replay
         // UI
         SDL_Keymod kmod = SDL_GetModState();                    // kmod : OR'd modifiers
+        PROF_SCOPE(&prof, PROF_EVENTS)
         { // Filtered
             SDL_PumpEvents();                                   // Update event queue
-            const Uint8 *k = SDL_GetKeyboardState(NULL);        // Get all keys
+            const Uint8 *k = record_keys(&rec, SDL_GetKeyboardState(NULL), &kmod); // Get all keys
             if(  k[SDL_SCANCODE_ESCAPE]  ) quit = true;         // Esc to quit
             if(0)
             { // Up/Down to zoom in/out
+                int *scale = &anims.scale[penguin];
                 if(  k[SDL_SCANCODE_UP]  )
                 {
-                    sprite_PI->scale++;
-                    if(  sprite_PI->scale>32  ) sprite_PI->scale=32;
-                    sprite_PI->render.x=(wI.w-sprite_PI->scale*sprite_PI->size)/2;
-                    sprite_PI->render.y=(wI.h-sprite_PI->scale*sprite_PI->size)/2;
-                    sprite_PI->render.w=sprite_PI->scale*sprite_PI->size;
-                    sprite_PI->render.h=sprite_PI->scale*sprite_PI->size;
+                    (*scale)++;
+                    if(  *scale>32  ) *scale=32;
+                    center_char_on_screen(&sim, penguin, wI);
                 }
                 if(  k[SDL_SCANCODE_DOWN]  )
                 {
-                    sprite_PI->scale--;
-                    if(  sprite_PI->scale<1  ) sprite_PI->scale=1;
-                    sprite_PI->render.x=(wI.w-sprite_PI->scale*sprite_PI->size)/2;
-                    sprite_PI->render.y=(wI.h-sprite_PI->scale*sprite_PI->size)/2;
-                    sprite_PI->render.w=sprite_PI->scale*sprite_PI->size;
-                    sprite_PI->render.h=sprite_PI->scale*sprite_PI->size;
+                    (*scale)--;
+                    if(  *scale<1  ) *scale=1;
+                    center_char_on_screen(&sim, penguin, wI);
                 }
             }
         }
+        PROF_SCOPE(&prof, PROF_EVENTS)
         { // Polled
             SDL_Event e;
-            while(  SDL_PollEvent(&e)  )
+            while(  record_poll_event(&rec, &e)  )
             {
                 if(  e.type == SDL_KEYDOWN  )
                 {
@@ -241,8 +293,7 @@ int main(int argc, char *argv[])
                             walk_direction = 1;
                             if(  kmod & (KMOD_LSHIFT|KMOD_RSHIFT)  )
                             { // DEBUG
-                                anim_next_frame(&sprite_PI->framenum, sprite_PI->framecnt);
-                                anim_load_frame(&sprite_PI->frame, sprite_PI->size, sprite_PI->framenum);
+                                sim_send(&sim, (SimCmd){.type=SIM_STEP_FRAME, .i=penguin, .step=1});
                             }
                             break;
                         case SDLK_LEFT:
@@ -250,8 +301,7 @@ int main(int argc, char *argv[])
                             walk_direction = -1;
                             if(  kmod & (KMOD_LSHIFT|KMOD_RSHIFT)  )
                             { // DEBUG
-                                anim_prev_frame(&sprite_PI->framenum, sprite_PI->framecnt);
-                                anim_load_frame(&sprite_PI->frame, sprite_PI->size, sprite_PI->framenum);
+                                sim_send(&sim, (SimCmd){.type=SIM_STEP_FRAME, .i=penguin, .step=-1});
                             }
                             break;
                         default: break;
@@ -270,6 +320,18 @@ int main(int argc, char *argv[])
                             break;
                     }
                 }
+                if(  (e.type == SDL_WINDOWEVENT) || (e.type == SDL_RENDER_TARGETS_RESET)  ) damage_mark(&damage); // Exposed, resized, ...
+                if(  (e.type == SDL_WINDOWEVENT) && (e.window.event == SDL_WINDOWEVENT_SIZE_CHANGED)  )
+                { // Stretch the old background until the new one is ready
+                    wI.w = e.window.data1; wI.h = e.window.data2;
+                    tb.bg_rect.w = wI.w;
+                    if(  bgnd_quad == false  ) bgnd_request(&bgnd_job, wI.w, wI.h);
+                    if(  dirty.target != NULL  ) dirty_resize(&dirty, ren, wI.w, wI.h);
+                }
+                if(  (e.type == SDL_MOUSEBUTTONDOWN) && (e.button.button == SDL_BUTTON_LEFT)  )
+                { // Click a character : its visible pixels, not its rect (see collide.h). Shown in the overlay.
+                    clicked = collide_hit(sim.view, e.button.x, e.button.y, drawn_alpha);
+                }
                 if(  e.type == SDL_TEXTINPUT  )
                 {
                     // Copy text
@@ -280,69 +342,97 @@ int main(int argc, char *argv[])
             }
         }
 
-        { // Animate
-            Sprite *sprite = walk_animation ? sprite_PW : sprite_PI;
-            if(  ticks < sprite->ticks_per_frame  ) ticks++;
-            else
+        PROF_SCOPE(&prof, PROF_ANIMATE)
+        { // Animate : fixed ticks (PACING_SIM_HZ ticks per second), here or on the simulation thread
+            float vx = walk_animation ? 1*sim.view->scale[penguin]*walk_direction : 0;
+            sim_send(&sim, (SimCmd){.type=SIM_CONTROL, .i=penguin, .clip=walk_animation ? clip_PW : clip_PI,
+                                    .dir=walk_direction, .vx=vx});
+            if(  sim.thread != NULL  ) while(  pacing_step(&pacing)  ) {} // Only keep time (see damage_wait)
+            else while(  record_step(&rec, &pacing)  ) anims_tick(&anims); // Advance every character
+        }
+        float alpha = (sim.thread != NULL) ? sim_acquire(&sim)  // Render between last two ticks
+                                           : record_alpha(&rec, &pacing);
+        const AnimSystem *view = sim.view;                      // Threaded : the newest snapshot
+        drawn_alpha = alpha;
+        if(  (bgnd_quad == false) && bgnd_poll(&bgnd_job, &bgnd_tex, ren)  ) damage_mark(&damage); // New size is ready after a resize
+        { // Idle mode: nothing changed since the last present, wait for input or the next frame change
+            uint64_t h = damage_hash_anims(DAMAGE_SEED, view, alpha);
+            h = damage_hash(h, &show_debug, sizeof(show_debug));
+            if(  show_debug  ) h = overlay_damage(h, view->clips[view->clip[penguin]], view->framenum[penguin],
+                                                 walk_animation, wI, debug_input_buffer, clicked);
+            if(  damage.dirty  ) dirty_full(&dirty);             // Whole window, not just the sprites
+            if(  damage_changed(&damage, h) == false  )
             {
-                anim_next_frame(&sprite->framenum, sprite->framecnt);
-                anim_load_frame(&sprite->frame, sprite->size, sprite->framenum);
-                ticks = 0;
+                bool busy = (assets_pending(&assets) > 0) || (bgnd_job.thread != NULL);
+                prof_cancel_frame(&prof);                       // Waiting is not a frame
+                damage_wait(&pacing, anims_next_change(view), busy);
+                continue;
             }
-            if(  walk_animation  ) char_penguin.x += 1*sprite->scale*walk_direction;
         }
 
         // Render
-        { // Paint over old video frame with a beautiful background gradient
-            SDL_RenderCopy(ren, bgnd_tex, NULL, NULL);
+        SDL_Rect graph = {0};                                   // Frame time graph, below the text box
+        PROF_SCOPE(&prof, PROF_OVERLAY)
+        if(show_debug)
+        { // Put text in the text box (drawn after the sprites)
+            Sprite *sprite = view->clips[view->clip[penguin]];
+            overlay_text(&overlay, sprite, view->framenum[penguin], walk_animation,
+                         wI, debug_input_buffer, clicked, &prof);
+            textbox_update(&tb, ren, debug_font, wI.w-tb.margin);  // Wrap text here
+            graph = (SDL_Rect){.x=tb.margin, .y=tb.bg_rect.h + tb.margin, .w=PROF_FRAMES/2, .h=60};
         }
-        { // Draw the sprite
-            /* SDL_RenderCopy(ren, tex_PI, NULL, NULL);           // Draw entire spritesheet */
-            Sprite *sprite = (walk_animation) ? sprite_PW : sprite_PI;
-            SDL_Texture *tex = (walk_animation) ? tex_PW : tex_PI;
-            SDL_RendererFlip flip = (walk_direction==1) ? SDL_FLIP_NONE : SDL_FLIP_HORIZONTAL;
-            /* SDL_RenderCopy(ren, tex, &sprite->frame, &sprite->render); // Draw one frame */
-            SDL_RenderCopyEx(ren, tex, &sprite->frame, &sprite->render, 0, NULL, flip); // Draw one frame
+        int nregions = 1;                                       // The whole window
+        if(  dirty.target != NULL  )
+        { // Dirty rects: only redraw where the sprites and the overlay are now and were last frame
+            for( int i=0; i<view->n; i++ ) dirty_add(&dirty, anims_render_rect(view, i, alpha));
+            if(  show_debug  ) { dirty_add(&dirty, tb.bg_rect); dirty_add(&dirty, graph); }
+            nregions = dirty_begin(&dirty, ren);
         }
-        if(show_debug)
-        { // Debug overlay
-            Sprite *sprite = (walk_animation) ? sprite_PW : sprite_PI;
-            { // Put text in the text box
-                char *d = tb.text;                              // d : see macro "print"
-                print("Spritesheet: "); print(sprite->path);
-                print(" | ");
-                print("Sprite size: "); printint(4, sprite->size); print("x"); printint(4, sprite->size);
-                print(" | ");
-                print("Animation frame: "); printint(3, sprite->framenum); print(" / "); printint(3, sprite->framecnt);
-                print(" | ");
-                print("Ticks per frame: "); printint(3, sprite->ticks_per_frame);
-                print(" | ");
-                print("Animation: "); if(walk_animation){ print("waddle");} else print("huff");
-                print(" | ");
-                print("Window size: "); printint(5, wI.w); print("x"); printint(5, wI.h); print(" (wxh)");
-                print("\nInput: "); print(debug_input_buffer);
-                SDL_Surface *surf = TTF_RenderText_Blended_Wrapped(debug_font, tb.text, tb.fg,
-                                                wI.w-tb.margin);   // Wrap text here
-                tb.tex = SDL_CreateTextureFromSurface(ren, surf);
-                SDL_FreeSurface(surf);
-                SDL_QueryTexture(tb.tex, NULL, NULL, &tb.fg_rect.w, &tb.fg_rect.h);
+        for( int r=0; r<nregions; r++ )
+        {
+            const SDL_Rect *clip = (dirty.target != NULL) ? dirty_clip(&dirty, ren, r) : NULL;
+            PROF_SCOPE(&prof, PROF_BGND)
+            { // Paint over old video frame with a beautiful background gradient
+                if(  bgnd_quad && (bgnd_draw_quad(ren, wI.w, wI.h) < 0)  )
+                { // Renderer cannot draw geometry: fall back to the texture
+                    bgnd_quad = false;
+                    bgnd_gradient(&bgnd_tex, ren, wI);
+                }
+                if(  bgnd_quad == false  ) SDL_RenderCopy(ren, bgnd_tex, NULL, NULL);
+            }
+            PROF_SCOPE(&prof, PROF_SPRITES)
+            { // Draw the sprites
+                /* SDL_RenderCopy(ren, sprite_PI->tex, NULL, NULL);  // Draw entire spritesheet */
+                batch_begin(&batch, ren);
+                anims_draw_clipped(view, &batch, alpha, clip);      // Queue one frame per character
+                batch_flush(&batch);                            // Draw all queued frames
             }
-            { // Draw text
-                tb.bg_rect.h = tb.fg_rect.h + 2*tb.margin;
-                SDL_SetRenderDrawColor(ren, tb.bg.r, tb.bg.g, tb.bg.b, tb.bg.a);
-                // Render bgnd
-                SDL_RenderFillRect(ren, &tb.bg_rect);
-                // Render text
-                SDL_RenderCopy(ren, tb.tex, NULL, &tb.fg_rect);
-                SDL_DestroyTexture(tb.tex);
+            PROF_SCOPE(&prof, PROF_OVERLAY)
+            if(show_debug)
+            { // Debug overlay
+                textbox_draw(&tb, ren);                         // Draw text
+                prof_draw_graph(&prof, ren, graph, 50);        // Frame times: top of graph is 50 ms
             }
         }
+        if(  dirty.target != NULL  ) dirty_end(&dirty, ren);   // Copy the kept scene to the window
         { // Present to screen
-            SDL_RenderPresent(ren);
-            SDL_Delay(10);
+            PROF_SCOPE(&prof, PROF_PRESENT) SDL_RenderPresent(ren);
+            if(  rec.mode != RECORD_REPLAY  ) pacing_end_frame(&pacing); // Sleep to the next frame
         }
     }
 
-    shutdown(debug_font, ren, win, bgnd_tex, tex_PI, tex_PW);
-    return EXIT_SUCCESS;
+    sim_stop(&sim);                                             // anims is ours again
+    prof_dump(&prof);                                           // See PROF_CSV, PROF_TRACE
+    if(  record_finish(&rec, record_checksum(&anims), &prof) != EXIT_SUCCESS  ) exit_code = EXIT_FAILURE;
+    watch_free(&watch);
+    assets_free(&assets);
+    bgnd_job_free(&bgnd_job);
+    dirty_free(&dirty);
+    textbox_free(&tb);
+    font_atlas_free(&debug_atlas);
+    atlas_free(&atlas);
+    batch_free(&batch);
+    anims_free(&anims);
+    shutdown(debug_font, ren, win, bgnd_tex, sprite_PI, sprite_PW);
+    return exit_code;
 }
@@ -0,0 +1,134 @@
+#ifndef __OVERLAY_H__
+#define __OVERLAY_H__
+/* *************Debug overlay text***************
+ * Build the debug overlay text for one frame.
+ *
+ * Example:
+ *      char text_buffer[1024];
+ *      Overlay overlay; overlay_init(&overlay, text_buffer, sizeof(text_buffer));
+ *      ...
+ *      overlay_text(&overlay, sprite, framenum, walk_animation, wI, input, clicked, &prof);
+ *      textbox_update(&tb, ren, debug_font, wI.w-tb.margin);
+ *
+ * The same function builds the overlay in main.c and in bench.c.
+ *
+ * Numbers go in fixed-width fields (see strbuf.h). While the sheet
+ * path and the input text stay the same, a frame only rewrites the
+ * fields and the profiler stats at the end. The text is built again
+ * when the sheet or the input changes.
+ * *******************************/
+#include <stdbool.h>
+#include <SDL.h>
+#include "window_info.h"
+#include "strbuf.h"
+#include "sprite.h"
+#include "prof.h"
+#include "damage.h"
+
+typedef enum
+{
+    OVERLAY_FRAME_W,
+    OVERLAY_FRAME_H,
+    OVERLAY_FRAMENUM,
+    OVERLAY_FRAMECNT,
+    OVERLAY_TICKS,
+    OVERLAY_ANIMATION,
+    OVERLAY_WINDOW_W,
+    OVERLAY_WINDOW_H,
+    OVERLAY_CLICKED,
+    OVERLAY_NFIELDS
+} OverlayField;
+
+const int overlay_width[OVERLAY_NFIELDS] = {4, 4, 3, 3, 3, 6, 5, 5, 5};
+
+typedef struct
+{
+    StrBuf sb;                          // The overlay text
+    uint64_t key;                       // Hash of the sheet and input the text was built with, 0 : none
+    int slot[OVERLAY_NFIELDS];          // Where each field starts in sb
+    int prof_start;                     // Profiler stats start here (last in the text)
+} Overlay;
+
+void overlay_init(Overlay *overlay, char *text_buffer, int len)
+{
+    strbuf_init(&overlay->sb, text_buffer, len);
+    overlay->key = 0;
+}
+
+void overlay_build(Overlay *overlay, const Sprite *sprite, const char *debug_input)
+{ // Write the text with empty fields
+    StrBuf *sb = &overlay->sb;
+    int *slot = overlay->slot;
+    strbuf_reset(sb);
+    strbuf_put(sb, "Spritesheet: "); strbuf_put(sb, sprite->path);
+    strbuf_put(sb, " | ");
+    strbuf_put(sb, "Sprite size: ");
+    slot[OVERLAY_FRAME_W] = strbuf_field(sb, overlay_width[OVERLAY_FRAME_W]); strbuf_put(sb, "x");
+    slot[OVERLAY_FRAME_H] = strbuf_field(sb, overlay_width[OVERLAY_FRAME_H]);
+    strbuf_put(sb, " | ");
+    strbuf_put(sb, "Animation frame: ");
+    slot[OVERLAY_FRAMENUM] = strbuf_field(sb, overlay_width[OVERLAY_FRAMENUM]); strbuf_put(sb, " / ");
+    slot[OVERLAY_FRAMECNT] = strbuf_field(sb, overlay_width[OVERLAY_FRAMECNT]);
+    strbuf_put(sb, " | ");
+    strbuf_put(sb, "Ticks per frame: ");
+    slot[OVERLAY_TICKS] = strbuf_field(sb, overlay_width[OVERLAY_TICKS]);
+    strbuf_put(sb, " | ");
+    strbuf_put(sb, "Animation: ");
+    slot[OVERLAY_ANIMATION] = strbuf_field(sb, overlay_width[OVERLAY_ANIMATION]);
+    strbuf_put(sb, " | ");
+    strbuf_put(sb, "Window size: ");
+    slot[OVERLAY_WINDOW_W] = strbuf_field(sb, overlay_width[OVERLAY_WINDOW_W]); strbuf_put(sb, "x");
+    slot[OVERLAY_WINDOW_H] = strbuf_field(sb, overlay_width[OVERLAY_WINDOW_H]); strbuf_put(sb, " (wxh)");
+    strbuf_put(sb, " | ");
+    strbuf_put(sb, "Clicked: ");
+    slot[OVERLAY_CLICKED] = strbuf_field(sb, overlay_width[OVERLAY_CLICKED]);
+    strbuf_put(sb, "\nInput: "); strbuf_put(sb, debug_input);
+    strbuf_put(sb, "\n");
+    overlay->prof_start = sb->len;
+}
+
+void overlay_text(Overlay *overlay, const Sprite *sprite, int framenum, bool walk_animation,
+                  WindowInfo wI, const char *debug_input, int clicked, const Profiler *prof)
+{ // Write the overlay text to overlay->sb (clicked : character under the last click, -1 : none)
+    uint64_t key = damage_hash(DAMAGE_SEED, &sprite, sizeof(sprite));
+    key = damage_hash(key, sprite->path, strlen(sprite->path));
+    key = damage_hash(key, debug_input, strlen(debug_input));
+    if(  key != overlay->key  )
+    { // New sheet or new input: lay the text out again
+        overlay_build(overlay, sprite, debug_input);
+        overlay->key = key;
+    }
+    StrBuf *sb = &overlay->sb;
+    const int *slot = overlay->slot;
+    const int *width = overlay_width;
+    strbuf_set_int(sb, slot[OVERLAY_FRAME_W],  width[OVERLAY_FRAME_W],  sprite->frame_w);
+    strbuf_set_int(sb, slot[OVERLAY_FRAME_H],  width[OVERLAY_FRAME_H],  sprite->frame_h);
+    strbuf_set_int(sb, slot[OVERLAY_FRAMENUM], width[OVERLAY_FRAMENUM], framenum);
+    strbuf_set_int(sb, slot[OVERLAY_FRAMECNT], width[OVERLAY_FRAMECNT], sprite->framecnt);
+    strbuf_set_int(sb, slot[OVERLAY_TICKS],    width[OVERLAY_TICKS],    sprite->ticks_per_frame);
+    strbuf_set_str(sb, slot[OVERLAY_ANIMATION], width[OVERLAY_ANIMATION], walk_animation ? "waddle" : "huff");
+    strbuf_set_int(sb, slot[OVERLAY_WINDOW_W], width[OVERLAY_WINDOW_W], wI.w);
+    strbuf_set_int(sb, slot[OVERLAY_WINDOW_H], width[OVERLAY_WINDOW_H], wI.h);
+    if(  clicked >= 0  ) strbuf_set_int(sb, slot[OVERLAY_CLICKED], width[OVERLAY_CLICKED], clicked);
+    else strbuf_set_str(sb, slot[OVERLAY_CLICKED], width[OVERLAY_CLICKED], "none");
+    strbuf_truncate(sb, overlay->prof_start);                   // Stats are last: rewrite them
+    prof_print_stats(prof, sb);
+}
+
+uint64_t overlay_damage(uint64_t h, const Sprite *sprite, int framenum, bool walk_animation,
+                        WindowInfo wI, const char *debug_input, int clicked)
+{ // Hash what overlay_text() writes, except the profiler stats (see damage.h)
+    h = damage_hash(h, &sprite, sizeof(sprite));
+    h = damage_hash(h, &sprite->framecnt, sizeof(int));
+    h = damage_hash(h, &sprite->ticks_per_frame, sizeof(int));
+    h = damage_hash(h, &sprite->frame_w, sizeof(int));
+    h = damage_hash(h, &sprite->frame_h, sizeof(int));
+    h = damage_hash(h, &framenum, sizeof(framenum));
+    h = damage_hash(h, &walk_animation, sizeof(walk_animation));
+    h = damage_hash(h, &wI.w, sizeof(wI.w));
+    h = damage_hash(h, &wI.h, sizeof(wI.h));
+    h = damage_hash(h, &clicked, sizeof(clicked));
+    return damage_hash(h, debug_input, strlen(debug_input));
+}
+
+#endif // __OVERLAY_H__
@@ -0,0 +1,124 @@
+#ifndef __PACING_H__
+#define __PACING_H__
+/* *************Frame pacing***************
+ * Fixed-timestep simulation, decoupled from rendering.
+ *
+ * The game loop used to be: input, animate one tick, render,
+ * SDL_Delay(10). Animation speed then depends on how long the
+ * render takes and on the machine load.
+ *
+ * Now the simulation always ticks PACING_SIM_HZ times per second of
+ * real time (measured with SDL_GetPerformanceCounter). Each video
+ * frame runs as many ticks as real time says (0, 1, or more), then
+ * renders positions interpolated between the last two ticks.
+ *
+ * Example:
+ *      Pacing pacing; pacing_init(&pacing, win, ren);
+ *      while(  quit == false  )
+ *      {
+ *          pacing_begin_frame(&pacing);                // Measure real time
+ *          ... input ...
+ *          while(  pacing_step(&pacing)  ) { ... animate one tick ... }
+ *          float alpha = pacing_alpha(&pacing);        // 0 to 1 : between last tick and next tick
+ *          ... render ...
+ *          SDL_RenderPresent(ren);
+ *          pacing_end_frame(&pacing);                  // Sleep until next frame
+ *      }
+ *
+ * Vsync: run with SDL_RENDER_VSYNC=1 in the environment. Then
+ * SDL_RenderPresent waits for the display and pacing does not sleep.
+ * Without vsync, pacing sleeps to hit the display refresh rate:
+ * SDL_Delay for most of the wait, then a short spin for the last
+ * millisecond (SDL_Delay can oversleep by a millisecond or more).
+ * *******************************/
+#include <SDL.h>
+
+#define PACING_SIM_HZ 100               // Game loop ticks per second (old loop: ~10 ms per tick)
+#define PACING_MAX_FRAME 0.25           // Max seconds of simulation per frame (e.g., after a stall)
+#define PACING_DEFAULT_FPS 60           // Target frame rate if display rate is unknown
+#define PACING_SPIN 0.001               // Seconds to spin instead of SDL_Delay
+
+typedef struct
+{
+    Uint64 freq;                        // Performance counter ticks per second
+    Uint64 frame_start;                 // Counter at start of this frame
+    double dt;                          // Seconds per simulation tick
+    double accum;                       // Real time not yet simulated
+    double frame_time;                  // Target seconds per frame
+    bool vsync;                         // Present waits for the display
+    Uint64 ticks;                       // Simulation ticks since start
+} Pacing;
+
+void pacing_init(Pacing *pacing, SDL_Window *win, SDL_Renderer *ren)
+{
+    pacing->freq = SDL_GetPerformanceFrequency();
+    pacing->frame_start = SDL_GetPerformanceCounter();
+    pacing->dt = 1.0/PACING_SIM_HZ;
+    pacing->accum = 0;
+    pacing->ticks = 0;
+    int fps = PACING_DEFAULT_FPS;
+    SDL_DisplayMode mode;
+    if(  (SDL_GetWindowDisplayMode(win, &mode) == 0) && (mode.refresh_rate > 0)  ) fps = mode.refresh_rate;
+    pacing->frame_time = 1.0/fps;
+    SDL_RendererInfo info;
+    pacing->vsync = (SDL_GetRendererInfo(ren, &info) == 0) && (info.flags & SDL_RENDERER_PRESENTVSYNC);
+}
+
+void pacing_init_sim(Pacing *pacing)
+{ // Pacing for a loop that only simulates, e.g., on its own thread (no window, a frame is one tick)
+    pacing->freq = SDL_GetPerformanceFrequency();
+    pacing->frame_start = SDL_GetPerformanceCounter();
+    pacing->dt = 1.0/PACING_SIM_HZ;
+    pacing->accum = 0;
+    pacing->ticks = 0;
+    pacing->frame_time = pacing->dt;
+    pacing->vsync = false;
+}
+
+double pacing_seconds(const Pacing *pacing, Uint64 from, Uint64 to)
+{ // Seconds between two performance counter values
+    return (double)(to - from)/(double)pacing->freq;
+}
+
+void pacing_begin_frame(Pacing *pacing)
+{ // Add the real time since the last frame to the time to simulate
+    Uint64 now = SDL_GetPerformanceCounter();
+    double elapsed = pacing_seconds(pacing, pacing->frame_start, now);
+    if(  elapsed > PACING_MAX_FRAME  ) elapsed = PACING_MAX_FRAME; // Do not try to catch up on a long stall
+    pacing->accum += elapsed;
+    pacing->frame_start = now;
+}
+
+bool pacing_step(Pacing *pacing)
+{ // Return true if there is a simulation tick to run (call in a loop)
+    if(  pacing->accum < pacing->dt  ) return false;
+    pacing->accum -= pacing->dt;
+    pacing->ticks++;
+    return true;
+}
+
+float pacing_alpha(const Pacing *pacing)
+{ // How far real time is between the last tick (0) and the next tick (1)
+    return (float)(pacing->accum/pacing->dt);
+}
+
+Uint32 pacing_ms_until(const Pacing *pacing, int ticks)
+{ // Milliseconds of real time until pacing_step has run ticks more ticks (rounded up)
+    double left = ticks*pacing->dt - pacing->accum
+                  - pacing_seconds(pacing, pacing->frame_start, SDL_GetPerformanceCounter());
+    return (left > 0) ? (Uint32)(left*1000) + 1 : 0;
+}
+
+void pacing_end_frame(const Pacing *pacing)
+{ // Sleep until it is time for the next frame (no sleep with vsync)
+    if(  pacing->vsync  ) return;
+    for(;;)
+    {
+        double left = pacing->frame_time - pacing_seconds(pacing, pacing->frame_start, SDL_GetPerformanceCounter());
+        if(  left <= 0  ) break;
+        if(  left > 2*PACING_SPIN  ) SDL_Delay((Uint32)((left - PACING_SPIN)*1000)); // Sleep most of it
+        // Spin the rest
+    }
+}
+
+#endif // __PACING_H__
@@ -0,0 +1,272 @@
+#ifndef __PROF_H__
+#define __PROF_H__
+/* *************Frame profiler***************
+ * Time each stage of the game loop, every frame.
+ *
+ * Example:
+ *      Profiler prof; prof_init(&prof);
+ *      while(  quit == false  )
+ *      {
+ *          prof_begin_frame(&prof);
+ *          PROF_SCOPE(&prof, PROF_EVENTS)
+ *          { // Everything in this block is timed as "events"
+ *              ...
+ *          }
+ *          ...
+ *      }
+ *      prof_dump(&prof);                   // CSV and/or Chrome trace, see below
+ *
+ * The last PROF_FRAMES frames are kept in a ring buffer. A loop
+ * iteration that draws nothing (e.g., idle, see damage.h) calls
+ * prof_cancel_frame(), so waiting is not counted as a frame.
+ * prof_draw_graph() draws frame times as a line graph.
+ * prof_print_stats() writes min/avg/p99 frame time for the overlay.
+ *
+ * Dump the ring buffer on exit by setting these in the environment:
+ *      PROF_CSV=prof.csv           one row per frame, one column per stage (ms)
+ *      PROF_TRACE=prof.json        open in chrome://tracing or ui.perfetto.dev
+ * *******************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <SDL.h>
+#include "strbuf.h"
+
+typedef enum
+{
+    PROF_EVENTS,                        // Poll input
+    PROF_ANIMATE,                       // Simulation ticks
+    PROF_BGND,                          // Background copy
+    PROF_SPRITES,                       // Sprite draw
+    PROF_OVERLAY,                       // Debug overlay build and draw
+    PROF_PRESENT,                       // SDL_RenderPresent
+    PROF_NSTAGES
+} ProfStage;
+
+const char *prof_stage_name[PROF_NSTAGES] = {"events", "animate", "bgnd", "sprites", "overlay", "present"};
+
+#define PROF_FRAMES 512                 // Frames in the ring buffer
+#define PROF_STATS_EVERY 30             // Update min/avg/p99 every this many frames
+#define PROF_RUNS (8*PROF_FRAMES)       // Stage runs kept for the trace (a stage can run once per dirty region)
+
+typedef struct
+{ // One run of a stage, for the trace
+    int stage;
+    float start_ms;                     // Since the start of its frame
+    float ms;
+} ProfRun;
+
+typedef struct
+{
+    Uint64 freq;                        // Performance counter ticks per second
+    Uint64 origin;                      // Counter at prof_init (trace time 0)
+    int head;                           // Ring index of the current frame
+    int count;                          // Frames recorded (max PROF_FRAMES)
+    Uint64 frame_start[PROF_FRAMES];    // Counter at start of each frame
+    float frame_ms[PROF_FRAMES];        // Start of frame to start of next frame
+    float stage_ms[PROF_FRAMES][PROF_NSTAGES];  // Sum of every run in the frame
+    Uint64 run_start[PROF_NSTAGES];     // Start of the stage's current run
+    ProfRun run[PROF_RUNS];             // Ring buffer of runs : run n is run[n % PROF_RUNS]
+    Uint32 nruns;                       // Runs recorded so far
+    Uint32 first_run[PROF_FRAMES];      // Number of the frame's first run
+    // Stats, updated every PROF_STATS_EVERY frames
+    float min_ms, avg_ms, p99_ms;
+    float stage_avg_ms[PROF_NSTAGES];
+    int frames_since_stats;
+    bool resume;                        // Last frame was cancelled : the frame before it is closed already
+} Profiler;
+
+void prof_init(Profiler *prof)
+{
+    SDL_zero(*prof);
+    prof->freq = SDL_GetPerformanceFrequency();
+    prof->origin = SDL_GetPerformanceCounter();
+    prof->head = -1;                                            // No frame yet
+}
+
+double prof_ms(const Profiler *prof, Uint64 from, Uint64 to)
+{ // Double : a float from prof->origin loses microseconds after a few minutes
+    return 1000.0*(double)(to - from)/(double)prof->freq;
+}
+
+int prof_compare_floats(const void *a, const void *b)
+{
+    float fa = *(const float *)a; float fb = *(const float *)b;
+    return (fa > fb) - (fa < fb);
+}
+
+void prof_update_stats(Profiler *prof)
+{ // min/avg/p99 over the completed frames in the ring buffer
+    int n = prof->count - 1;                                    // Current frame is not done
+    if(  n < 1  ) return;
+    float sorted[PROF_FRAMES];
+    float stage_sum[PROF_NSTAGES] = {0};
+    double sum = 0;
+    for( int k=0; k<n; k++ )
+    {
+        int i = (prof->head - 1 - k + PROF_FRAMES) % PROF_FRAMES;
+        sorted[k] = prof->frame_ms[i];
+        sum += sorted[k];
+        for( int s=0; s<PROF_NSTAGES; s++ ) stage_sum[s] += prof->stage_ms[i][s];
+    }
+    qsort(sorted, n, sizeof(float), prof_compare_floats);
+    prof->min_ms = sorted[0];
+    prof->avg_ms = (float)(sum/n);
+    prof->p99_ms = sorted[(n*99)/100];
+    for( int s=0; s<PROF_NSTAGES; s++ ) prof->stage_avg_ms[s] = stage_sum[s]/n;
+}
+
+void prof_begin_frame(Profiler *prof)
+{ // Close the last frame and start a new one
+    Uint64 now = SDL_GetPerformanceCounter();
+    if(  (prof->head >= 0) && (prof->resume == false)  )
+    {
+        prof->frame_ms[prof->head] = (float)prof_ms(prof, prof->frame_start[prof->head], now);
+    }
+    prof->resume = false;
+    prof->head = (prof->head + 1) % PROF_FRAMES;
+    if(  prof->count < PROF_FRAMES  ) prof->count++;
+    prof->frame_start[prof->head] = now;
+    prof->first_run[prof->head] = prof->nruns;
+    for( int s=0; s<PROF_NSTAGES; s++ ) prof->stage_ms[prof->head][s] = 0;
+    if(  ++prof->frames_since_stats >= PROF_STATS_EVERY  )
+    {
+        prof_update_stats(prof);
+        prof->frames_since_stats = 0;
+    }
+}
+
+void prof_cancel_frame(Profiler *prof)
+{ // Drop the frame begun last (it drew nothing). The next prof_begin_frame takes its place.
+    /* *************DOC***************
+     * The frame before it keeps its frame_ms (its start to the start
+     * of the dropped frame), so time spent waiting for input is not
+     * in any frame and does not skew min/avg/p99 or the graph.
+     * *******************************/
+    if(  prof->head < 0  ) return;
+    prof->nruns = prof->first_run[prof->head];                  // Its runs too
+    prof->head = (prof->head + PROF_FRAMES - 1) % PROF_FRAMES;
+    prof->count--;
+    prof->frames_since_stats--;
+    if(  prof->count == 0  ) prof->head = -1;                   // No frame yet
+    prof->resume = true;
+}
+
+void prof_begin(Profiler *prof, ProfStage stage)
+{
+    prof->run_start[stage] = SDL_GetPerformanceCounter();
+}
+
+void prof_end(Profiler *prof, ProfStage stage)
+{ // Add time since prof_begin to this stage. A stage can run more than once per frame: each run is kept for the trace.
+    float ms = (float)prof_ms(prof, prof->run_start[stage], SDL_GetPerformanceCounter());
+    prof->stage_ms[prof->head][stage] += ms;
+    ProfRun *run = &prof->run[prof->nruns % PROF_RUNS];
+    run->stage = stage;
+    run->start_ms = (float)prof_ms(prof, prof->frame_start[prof->head], prof->run_start[stage]);
+    run->ms = ms;
+    prof->nruns++;
+}
+
+// Time the block that follows: PROF_SCOPE(&prof, PROF_BGND) { ... }
+// (Do not leave the block with break or return: the end time would be skipped.)
+#define PROF_SCOPE(prof, stage) \
+    for( int _prof_once = (prof_begin((prof), (stage)), 1); _prof_once; _prof_once = 0, prof_end((prof), (stage)) )
+
+void prof_print_stats(const Profiler *prof, StrBuf *sb)
+{ // Append frame time stats to sb
+    strbuf_put(sb, "Frame ms: min "); strbuf_fixed(sb, prof->min_ms, 2);
+    strbuf_put(sb, " avg ");          strbuf_fixed(sb, prof->avg_ms, 2);
+    strbuf_put(sb, " p99 ");          strbuf_fixed(sb, prof->p99_ms, 2);
+    strbuf_put(sb, " |");
+    for( int s=0; s<PROF_NSTAGES; s++ )
+    {
+        strbuf_put(sb, " "); strbuf_put(sb, prof_stage_name[s]);
+        strbuf_put(sb, " "); strbuf_fixed(sb, prof->stage_avg_ms[s], 2);
+    }
+}
+
+void prof_draw_graph(const Profiler *prof, SDL_Renderer *ren, SDL_Rect area, float max_ms)
+{ // Line graph of frame times, oldest on the left. A frame of max_ms reaches the top of area.
+    SDL_SetRenderDrawColor(ren, 0, 0, 0, 127);
+    SDL_RenderFillRect(ren, &area);
+    { // Reference lines at 1/60 s and 1/30 s
+        SDL_SetRenderDrawColor(ren, 255, 255, 255, 80);
+        float refs[] = {1000.0f/60, 1000.0f/30};
+        for( int r=0; r<2; r++ )
+        {
+            if(  refs[r] > max_ms  ) continue;
+            int y = area.y + area.h - (int)(area.h*refs[r]/max_ms);
+            SDL_RenderDrawLine(ren, area.x, y, area.x + area.w - 1, y);
+        }
+    }
+    int n = prof->count - 1;                                    // Completed frames
+    if(  n > area.w  ) n = area.w;                              // One pixel per frame
+    if(  n < 2  ) return;
+    SDL_Point pts[PROF_FRAMES];
+    for( int k=0; k<n; k++ )
+    {
+        int i = (prof->head - n + k + PROF_FRAMES) % PROF_FRAMES;
+        float ms = prof->frame_ms[i];
+        if(  ms > max_ms  ) ms = max_ms;
+        pts[k] = (SDL_Point){.x=area.x + area.w - n + k, .y=area.y + area.h - 1 - (int)((area.h-1)*ms/max_ms)};
+    }
+    SDL_SetRenderDrawColor(ren, 255, 220, 0, 255);
+    SDL_RenderDrawLines(ren, pts, n);
+}
+
+void prof_dump(const Profiler *prof)
+{ // Write completed frames to $PROF_CSV and $PROF_TRACE (if set)
+    int n = prof->count - 1;
+    const char *csv_path = getenv("PROF_CSV");
+    if(  (csv_path != NULL) && (n > 0)  )
+    {
+        FILE *f = fopen(csv_path, "w");
+        if(  f == NULL  ) printf("Cannot write \"%s\"\n", csv_path);
+        else
+        {
+            fprintf(f, "frame,frame_ms");
+            for( int s=0; s<PROF_NSTAGES; s++ ) fprintf(f, ",%s_ms", prof_stage_name[s]);
+            fprintf(f, "\n");
+            for( int k=0; k<n; k++ )
+            {
+                int i = (prof->head - n + k + PROF_FRAMES) % PROF_FRAMES;
+                fprintf(f, "%d,%.4f", k, prof->frame_ms[i]);
+                for( int s=0; s<PROF_NSTAGES; s++ ) fprintf(f, ",%.4f", prof->stage_ms[i][s]);
+                fprintf(f, "\n");
+            }
+            fclose(f);
+            printf("Wrote %d frames to \"%s\"\n", n, csv_path);
+        }
+    }
+    const char *trace_path = getenv("PROF_TRACE");
+    if(  (trace_path != NULL) && (n > 0)  )
+    { // Chrome trace event format: one complete event ("ph":"X") per frame and per stage run
+        FILE *f = fopen(trace_path, "w");
+        if(  f == NULL  ) printf("Cannot write \"%s\"\n", trace_path);
+        else
+        {
+            fprintf(f, "{\"traceEvents\":[\n");
+            for( int k=0; k<n; k++ )
+            {
+                int i = (prof->head - n + k + PROF_FRAMES) % PROF_FRAMES;
+                double ts = 1000.0*prof_ms(prof, prof->origin, prof->frame_start[i]);  // Microseconds
+                fprintf(f, "%s{\"name\":\"frame\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.1f,\"dur\":%.1f}",
+                        (k > 0) ? ",\n" : "", ts, 1000.0*prof->frame_ms[i]);
+                Uint32 end = prof->first_run[(i + 1) % PROF_FRAMES];   // First run of the next frame
+                for( Uint32 r=prof->first_run[i]; r != end; r++ )
+                {
+                    if(  prof->nruns - r > PROF_RUNS  ) continue;      // Overwritten
+                    const ProfRun *run = &prof->run[r % PROF_RUNS];
+                    fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":2,\"ts\":%.1f,\"dur\":%.1f}",
+                            prof_stage_name[run->stage], ts + 1000.0*run->start_ms, 1000.0*run->ms);
+                }
+            }
+            fprintf(f, "\n]}\n");
+            fclose(f);
+            printf("Wrote %d frames to \"%s\"\n", n, trace_path);
+        }
+    }
+}
+
+#endif // __PROF_H__
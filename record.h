@@ -0,0 +1,373 @@
+#ifndef __RECORD_H__
+#define __RECORD_H__
+/* *************Record and replay***************
+ * Record the input of a run, then replay it as fast as possible.
+ *
+ * Record: the game runs as usual and writes its input to a log.
+ *      $ RECORD_INPUT=run.rec ./q.exe
+ * Replay: the input comes from the log, not the keyboard. Frames run
+ * back to back (no sleep, no idle wait, every frame is rendered).
+ *      $ REPLAY_INPUT=run.rec ./q.exe
+ *
+ * Both print the frame count, total simulation and render time, and
+ * a checksum of the final animation state (every character's
+ * position, frame number, tick count and direction). Replay compares
+ * the checksum to the one in the log and exits with EXIT_FAILURE if
+ * they differ: the same input no longer gives the same behavior.
+ *
+ * Example:
+ *      Record rec; record_init(&rec, win, &wI);    // Replay: window is resized to the recorded size
+ *      while(  quit == false  )
+ *      {
+ *          pacing_begin_frame(&pacing);
+ *          prof_begin_frame(&prof);
+ *          if(  record_begin_frame(&rec, &prof) == false  ) break; // End of the log
+ *          const Uint8 *k = record_keys(&rec, SDL_GetKeyboardState(NULL), &kmod);
+ *          while(  record_poll_event(&rec, &e)  ) { ... }
+ *          while(  record_step(&rec, &pacing)  ) { ... animate one tick ... }
+ *          float alpha = record_alpha(&rec, &pacing);
+ *          ... render ...
+ *      }
+ *      exit_code = record_finish(&rec, record_checksum(&anims), &prof);
+ *
+ * Log (native byte order, one record per tag byte):
+ *      RecordHeader
+ *      'K' : Uint16 kmod, Uint16 n, n x Uint16 scancodes held down   (once per frame)
+ *      'V' : Uint32 type, 3 x Sint32 (key: sym, mod, repeat;
+ *            window: event, data1, data2), text input: Uint8 len, text
+ *      'T' : Uint16 ticks, float alpha                                (ends the frame)
+ *      'E' : Uint32 frames, Uint64 checksum                           (end of the log)
+ *
+ * Only the events main.c reads are logged. A replay needs the same
+ * sprite sheets: both modes wait for every sheet to load before the
+ * first frame, and do not hot-reload sheets. A truncated or corrupt
+ * log stops the replay at that frame, and record_finish() fails.
+ * *******************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <SDL.h>
+#include "window_info.h"
+#include "pacing.h"
+#include "prof.h"
+#include "anims.h"
+#include "damage.h"
+
+#define RECORD_MAGIC "QREC"
+#define RECORD_VERSION 1
+
+typedef enum
+{
+    RECORD_OFF,
+    RECORD_WRITE,                       // Live input, written to the log
+    RECORD_REPLAY                       // Input read from the log
+} RecordMode;
+
+typedef struct
+{
+    char magic[4];                      // RECORD_MAGIC
+    Uint32 version;                     // RECORD_VERSION
+    Uint32 sim_hz;                      // PACING_SIM_HZ of the recording
+    Sint32 w, h;                        // Window size at the start
+} RecordHeader;
+
+typedef struct
+{
+    RecordMode mode;
+    SDL_Window *win;                    // Replay : resized as in the recording
+    const char *path;
+    FILE *f;                            // Write : the log
+    Uint8 *log; size_t len, pos;        // Replay : the whole log, read position
+    int ticks;                          // Write : ticks this frame. Replay : ticks left this frame.
+    bool frame_ended;                   // Replay : read this frame's 'T'
+    bool cut;                           // Replay : the log is truncated or corrupt, the replay ends
+    float alpha;
+    Uint8 keys[SDL_NUM_SCANCODES];      // Replay : keyboard state
+    SDL_Keymod kmod;
+    Uint32 frames;
+    Uint64 start;                       // Performance counter at the first frame
+    double stage_ms[PROF_NSTAGES];      // Sum over every drawn frame
+    Uint64 added;                       // frame_start of the last profiler frame added to stage_ms
+} Record;
+
+int record_init(Record *rec, SDL_Window *win, WindowInfo *wI)
+{ // Start recording or replaying if RECORD_INPUT or REPLAY_INPUT is set. Return -1 on error.
+    *rec = (Record){.mode=RECORD_OFF, .win=win};
+    RecordHeader hdr = {.version=RECORD_VERSION, .sim_hz=PACING_SIM_HZ, .w=wI->w, .h=wI->h};
+    memcpy(hdr.magic, RECORD_MAGIC, 4);
+    if(  (rec->path = getenv("REPLAY_INPUT")) != NULL  )
+    {
+        FILE *f = fopen(rec->path, "rb");
+        if(  f == NULL  ) { printf("Cannot open replay \"%s\"\n", rec->path); return -1; }
+        fseek(f, 0, SEEK_END);
+        long len = ftell(f);
+        fseek(f, 0, SEEK_SET);
+        rec->log = (len > 0) ? malloc(len) : NULL;
+        rec->len = (rec->log != NULL) ? fread(rec->log, 1, len, f) : 0;
+        fclose(f);
+        RecordHeader want = hdr;
+        if(  rec->len >= sizeof(hdr)  ) memcpy(&hdr, rec->log, sizeof(hdr));
+        if(  (rec->len < sizeof(hdr)) || (memcmp(hdr.magic, want.magic, 4) != 0)
+             || (hdr.version != want.version) || (hdr.sim_hz != want.sim_hz)  )
+        {
+            printf("\"%s\" is not a replay of this version (needs %s version %d, %d Hz)\n",
+                   rec->path, RECORD_MAGIC, RECORD_VERSION, PACING_SIM_HZ);
+            free(rec->log); rec->log = NULL;
+            return -1;
+        }
+        rec->pos = sizeof(hdr);
+        rec->mode = RECORD_REPLAY;
+        if(  (hdr.w != wI->w) || (hdr.h != wI->h)  )
+        { // Same window size as the recording
+            SDL_SetWindowSize(win, hdr.w, hdr.h);
+            wI->w = hdr.w; wI->h = hdr.h;
+        }
+        printf("Replaying \"%s\"\n", rec->path);
+    }
+    else if(  (rec->path = getenv("RECORD_INPUT")) != NULL  )
+    {
+        rec->f = fopen(rec->path, "wb");
+        if(  (rec->f == NULL) || (fwrite(&hdr, sizeof(hdr), 1, rec->f) != 1)  )
+        {
+            printf("Cannot write \"%s\"\n", rec->path);
+            if(  rec->f != NULL  ) fclose(rec->f);
+            return -1;
+        }
+        rec->mode = RECORD_WRITE;
+        printf("Recording input to \"%s\"\n", rec->path);
+    }
+    return 0;
+}
+
+bool record_active(const Record *rec)
+{
+    return rec->mode != RECORD_OFF;
+}
+
+void record_cut(Record *rec)
+{ // Replay : the log is truncated or corrupt. Skip to its end, so the replay stops at the next frame.
+    rec->cut = true;
+    rec->pos = rec->len;
+}
+
+bool record_read(Record *rec, void *dst, size_t n)
+{ // Replay : copy the next n bytes of the log. Return false if the log ends first (a truncated record).
+    if(  rec->pos + n > rec->len  ) { record_cut(rec); return false; }
+    memcpy(dst, rec->log + rec->pos, n);
+    rec->pos += n;
+    return true;
+}
+
+bool record_tag(Record *rec, char tag)
+{ // Replay : if the next record is tag, step over the tag and return true
+    if(  (rec->pos >= rec->len) || (rec->log[rec->pos] != (Uint8)tag)  ) return false;
+    rec->pos++;
+    return true;
+}
+
+void record_add_frame(Record *rec, const Profiler *prof, int index)
+{ // Add the stage times of profiler frame index to the totals, once
+    /* *************DOC***************
+     * An idle frame is cancelled (prof_cancel_frame): the frame
+     * before it is the last one again, and must not count twice.
+     * *******************************/
+    if(  (index < 0) || (prof->frame_start[index] == rec->added)  ) return;
+    rec->added = prof->frame_start[index];
+    for( int s=0; s<PROF_NSTAGES; s++ ) rec->stage_ms[s] += prof->stage_ms[index][s];
+}
+
+bool record_begin_frame(Record *rec, const Profiler *prof)
+{ // Call at the top of the frame. Return false at the end of the replay.
+    if(  rec->mode == RECORD_OFF  ) return true;
+    if(  rec->frames == 0  ) rec->start = SDL_GetPerformanceCounter();
+    else record_add_frame(rec, prof, (prof->head + PROF_FRAMES - 1) % PROF_FRAMES); // prof_begin_frame has started this one
+    rec->frames++;
+    rec->ticks = 0;
+    rec->frame_ended = false;
+    if(  rec->mode == RECORD_WRITE  ) return true;
+    Uint16 kmod = 0, n = 0;
+    if(  (record_tag(rec, 'K') == false) || (record_read(rec, &kmod, 2) == false)
+         || (record_read(rec, &n, 2) == false)  )
+    { // 'E' or a cut log
+        rec->frames--;
+        return false;
+    }
+    rec->kmod = (SDL_Keymod)kmod;
+    memset(rec->keys, 0, sizeof(rec->keys));
+    for( int i=0; i<n; i++ )
+    {
+        Uint16 code = 0;
+        if(  record_read(rec, &code, 2) && (code < SDL_NUM_SCANCODES)  ) rec->keys[code] = 1;
+    }
+    return true;
+}
+
+const Uint8 *record_keys(Record *rec, const Uint8 *k, SDL_Keymod *kmod)
+{ // Return the keyboard state to use this frame (and set kmod). Call once per frame.
+    if(  rec->mode == RECORD_REPLAY  ) { *kmod = rec->kmod; return rec->keys; }
+    if(  rec->mode == RECORD_WRITE  )
+    {
+        Uint16 mod = (Uint16)*kmod, n = 0;
+        for( int i=0; i<SDL_NUM_SCANCODES; i++ ) n += (k[i] != 0);
+        fputc('K', rec->f); fwrite(&mod, 2, 1, rec->f); fwrite(&n, 2, 1, rec->f);
+        for( Uint16 i=0; i<SDL_NUM_SCANCODES; i++ ) if(  k[i]  ) fwrite(&i, 2, 1, rec->f);
+    }
+    return k;
+}
+
+int record_poll_event(Record *rec, SDL_Event *e)
+{ // Same as SDL_PollEvent. Replay : events come from the log (live events are dropped).
+    if(  rec->mode == RECORD_REPLAY  )
+    {
+        SDL_FlushEvents(SDL_FIRSTEVENT, SDL_LASTEVENT);
+        if(  record_tag(rec, 'V') == false  ) return 0;         // Next is this frame's 'T'
+        Uint32 type = 0; Sint32 v[3] = {0};
+        if(  (record_read(rec, &type, 4) == false) || (record_read(rec, v, sizeof(v)) == false)  ) return 0;
+        SDL_zerop(e);
+        e->type = type;
+        if(  (type == SDL_KEYDOWN) || (type == SDL_KEYUP)  )
+        {
+            e->key.keysym.sym = v[0]; e->key.keysym.mod = (Uint16)v[1]; e->key.repeat = (Uint8)v[2];
+        }
+        else if(  type == SDL_WINDOWEVENT  )
+        {
+            e->window.event = (Uint8)v[0]; e->window.data1 = v[1]; e->window.data2 = v[2];
+            if(  e->window.event == SDL_WINDOWEVENT_SIZE_CHANGED  ) SDL_SetWindowSize(rec->win, v[1], v[2]);
+        }
+        else if(  type == SDL_TEXTINPUT  )
+        {
+            Uint8 len = 0;
+            if(  record_read(rec, &len, 1) == false  ) return 0;
+            if(  len >= SDL_TEXTINPUTEVENT_TEXT_SIZE  ) { record_cut(rec); return 0; } // Never written: corrupt
+            if(  record_read(rec, e->text.text, len) == false  ) return 0;
+            e->text.text[len] = '\0';
+        }
+        return 1;
+    }
+    int ret = SDL_PollEvent(e);
+    if(  (ret == 0) || (rec->mode == RECORD_OFF)  ) return ret;
+    Sint32 v[3] = {0};
+    switch(  e->type  )
+    {
+        case SDL_KEYDOWN: case SDL_KEYUP:
+            v[0] = e->key.keysym.sym; v[1] = e->key.keysym.mod; v[2] = e->key.repeat;
+            break;
+        case SDL_WINDOWEVENT:
+            v[0] = e->window.event; v[1] = e->window.data1; v[2] = e->window.data2;
+            break;
+        case SDL_TEXTINPUT: case SDL_RENDER_TARGETS_RESET:
+            break;
+        default: return ret;                                    // main.c does not read it: not logged
+    }
+    fputc('V', rec->f); fwrite(&e->type, 4, 1, rec->f); fwrite(v, sizeof(v), 1, rec->f);
+    if(  e->type == SDL_TEXTINPUT  )
+    {
+        Uint8 len = (Uint8)strlen(e->text.text);
+        fwrite(&len, 1, 1, rec->f); fwrite(e->text.text, 1, len, rec->f);
+    }
+    return ret;
+}
+
+bool record_step(Record *rec, Pacing *pacing)
+{ // Same as pacing_step. Replay : run the ticks in the log instead.
+    if(  rec->mode != RECORD_REPLAY  )
+    {
+        bool step = pacing_step(pacing);
+        rec->ticks += step;
+        return step;
+    }
+    if(  rec->frame_ended == false  )
+    { // Read this frame's 'T' (skip events nobody polled)
+        SDL_Event e;
+        while(  record_poll_event(rec, &e)  ) {}
+        Uint16 ticks = 0; rec->alpha = 0;
+        if(  (record_tag(rec, 'T') == false) || (record_read(rec, &ticks, 2) == false)
+             || (record_read(rec, &rec->alpha, 4) == false)  )
+        { // Every frame ends with 'T'
+            record_cut(rec);
+            ticks = 0; rec->alpha = 0;
+        }
+        rec->ticks = ticks;
+        rec->frame_ended = true;
+    }
+    if(  rec->ticks == 0  ) return false;
+    rec->ticks--;
+    pacing->ticks++;
+    return true;
+}
+
+float record_alpha(Record *rec, const Pacing *pacing)
+{ // Same as pacing_alpha. Call once per frame, after the ticks. Write : ends the frame in the log.
+    if(  rec->mode == RECORD_REPLAY  ) return rec->alpha;
+    float alpha = pacing_alpha(pacing);
+    if(  rec->mode == RECORD_WRITE  )
+    {
+        Uint16 ticks = (Uint16)rec->ticks;
+        fputc('T', rec->f); fwrite(&ticks, 2, 1, rec->f); fwrite(&alpha, 4, 1, rec->f);
+    }
+    return alpha;
+}
+
+uint64_t record_checksum(const AnimSystem *anims)
+{ // Hash the animation state (FNV-1a, see damage.h)
+    uint64_t h = DAMAGE_SEED;
+    for( int i=0; i<anims->n; i++ )
+    {
+        h = damage_hash(h, &anims->x[i], sizeof(float));
+        h = damage_hash(h, &anims->y[i], sizeof(float));
+        h = damage_hash(h, &anims->clip[i], sizeof(int));
+        h = damage_hash(h, &anims->framenum[i], sizeof(int));
+        h = damage_hash(h, &anims->tick[i], sizeof(int));
+        h = damage_hash(h, &anims->dir[i], sizeof(int));
+    }
+    return h;
+}
+
+int record_finish(Record *rec, uint64_t checksum, const Profiler *prof)
+{ // Close the log and print the totals. Return EXIT_FAILURE if the replay checksum differs.
+    if(  rec->mode == RECORD_OFF  ) return EXIT_SUCCESS;
+    double wall_ms = (rec->frames > 0) ? 1000.0*(SDL_GetPerformanceCounter() - rec->start)/prof->freq : 0;
+    if(  rec->frames > 0  ) record_add_frame(rec, prof, prof->head);
+    double render_ms = rec->stage_ms[PROF_BGND] + rec->stage_ms[PROF_SPRITES]
+                       + rec->stage_ms[PROF_OVERLAY] + rec->stage_ms[PROF_PRESENT];
+    printf("%s %u frames: simulation %.2f ms, render %.2f ms, wall %.2f ms\n",
+           (rec->mode == RECORD_WRITE) ? "Recorded" : "Replayed", rec->frames,
+           rec->stage_ms[PROF_ANIMATE], render_ms, wall_ms);
+    for( int s=0; s<PROF_NSTAGES; s++ ) printf("    %-8s %10.2f ms\n", prof_stage_name[s], rec->stage_ms[s]);
+    printf("Checksum: %016llx\n", (unsigned long long)checksum);
+    int ret = EXIT_SUCCESS;
+    if(  rec->mode == RECORD_WRITE  )
+    {
+        fputc('E', rec->f); fwrite(&rec->frames, 4, 1, rec->f); fwrite(&checksum, 8, 1, rec->f);
+        if(  fclose(rec->f) != 0  ) { printf("Cannot write \"%s\"\n", rec->path); ret = EXIT_FAILURE; }
+    }
+    else
+    {
+        Uint32 frames = 0; Uint64 want = 0;
+        if(  rec->cut  )
+        {
+            printf("\"%s\" is truncated or corrupt\n", rec->path);
+            ret = EXIT_FAILURE;
+        }
+        else if(  (record_tag(rec, 'E') == false) || (record_read(rec, &frames, 4) == false)
+                  || (record_read(rec, &want, 8) == false)  )
+        {
+            printf("Replay stopped before the end of \"%s\"\n", rec->path);
+            ret = EXIT_FAILURE;
+        }
+        else if(  (want != checksum) || (frames != rec->frames)  )
+        {
+            printf("Replay does not match the recording: checksum %016llx, %u frames\n",
+                   (unsigned long long)want, frames);
+            ret = EXIT_FAILURE;
+        }
+        else puts("Replay matches the recording");
+        free(rec->log);
+    }
+    rec->mode = RECORD_OFF;
+    return ret;
+}
+
+#endif // __RECORD_H__
@@ -0,0 +1,256 @@
+/* *************DOC***************
+ * Audit every sprite sheet in a folder: one table row per sheet.
+ *
+ * Example
+ * -------
+ * ./sheet-audit.exe art audit.tsv
+ *
+ * Arguments
+ * ---------
+ * 1 : folder of .png sprite sheets (default: art)
+ * 2 : table to write (default: audit.tsv)
+ * 3 : number of threads (default: one per CPU)
+ *
+ * Output
+ * ------
+ * Tab-separated, one header line, then one line per sheet (sorted
+ * by path). Messages (e.g., a file that fails to decode) go to
+ * stdout, not to the table.
+ *
+ * path         sheet path, "folder/file.png"
+ * status       ok
+ *              opaque : top-left pixel is not transparent, the game
+ *                       refuses the sheet (sprite_sheet_has_transparency)
+ *              error  : the png did not decode, or is empty
+ * sheet_w/h    sheet size in pixels
+ * transparent  % of pixels with alpha 0
+ * frame_w/h    frame size (layout descriptor, else detected, see layout.h)
+ * frames       frames in the animation
+ * cells        grid cells (frames, if the layout lists rects)
+ * empty        cells with no visible pixels
+ * dups         frames with the same pixels as an earlier frame
+ * bbox_x/y/w/h smallest box, in frame coordinates, that holds the
+ *              visible pixels of every frame
+ * wasted       % of the sheet not covered by a visible, unique frame
+ *              (trimmed to its alpha bounds)
+ *
+ * Sheets are decoded and scanned by a pool of threads (no window,
+ * no renderer). The scan is the one the game does at load time
+ * (sprite_load_info).
+ * *******************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <dirent.h>
+#include <SDL.h>
+#include <SDL_image.h>
+#include "sprite.h"
+#include "atlas.h"
+
+#define AUDIT_PATH_LEN 256
+#define AUDIT_MAX_THREADS 64
+
+typedef struct
+{
+    char path[AUDIT_PATH_LEN];
+    const char *status;                 // "ok", "opaque", "error"
+    int sheet_w, sheet_h;
+    float transparent;                  // % of pixels
+    int frame_w, frame_h;
+    int frames, cells, empty, dups;
+    SDL_Rect bbox;                      // In frame coordinates
+    float wasted;                       // % of the sheet
+} SheetReport;
+
+typedef struct
+{
+    SheetReport *reports;
+    int n;
+    SDL_atomic_t next;                  // Next report to fill
+} AuditJob;
+
+int compare_names(const void *a, const void *b)
+{ // Sort reports by path so the table is the same every time
+    return strcmp(((const SheetReport *)a)->path, ((const SheetReport *)b)->path);
+}
+
+bool is_png(const char *name)
+{
+    size_t len = strlen(name);
+    return (len > 4) && (strcmp(name + len - 4, ".png") == 0);
+}
+
+int count_bits(const uint32_t *bits, int n)
+{ // Number of 1 bits in the first n bits
+    int cnt = 0;
+    for( int i=0; i<n; i++ ) cnt += (bits[i/32] >> (i%32)) & 1u;
+    return cnt;
+}
+
+float transparent_percent(SDL_Surface *surf)
+{ // % of the pixels of a 32-bit surface with alpha 0 (no alpha channel : pixel is 0)
+    uint32_t amask = surf->format->Amask;
+    if(  amask == 0  ) amask = 0xFFFFFFFF;
+    long clear = 0;
+    for( int y=0; y<surf->h; y++ )
+    {
+        const uint32_t *p = (const uint32_t *)((const uint8_t *)surf->pixels + y*surf->pitch);
+        for( int x=0; x<surf->w; x++ ) clear += ((p[x] & amask) == 0);
+    }
+    return (surf->w*surf->h > 0) ? 100.0f*clear/((long)surf->w*surf->h) : 0;
+}
+
+void audit_sheet(SheetReport *rep, Sprite *sprite)
+{ // Decode and scan one sheet into rep
+    SDL_Surface *surf = sprite_decode_surface(rep->path);
+    if(  surf == NULL  ) { rep->status = "error"; return; }    // Message is printed
+    if(  (surf->w <= 0) || (surf->h <= 0)  )
+    { // No pixels to check
+        printf("\"%s\" is empty\n", rep->path);
+        rep->status = "error";
+        SDL_FreeSurface(surf);
+        return;
+    }
+    rep->status = (*(uint32_t *)surf->pixels == 0) ? "ok" : "opaque";   // Same check as the game
+    rep->sheet_w = surf->w; rep->sheet_h = surf->h;
+    rep->transparent = transparent_percent(surf);
+
+    *sprite = (Sprite){.path = rep->path};
+    sprite_load_info(sprite, surf);
+    rep->frame_w = sprite->frame_w; rep->frame_h = sprite->frame_h;
+    rep->frames = sprite->framecnt;
+    if(  sprite->cols*sprite->rows > 0  )
+    { // Grid: every cell, including the ones after the last frame
+        rep->cells = sprite->cols*sprite->rows;
+        if(  rep->cells > SPRITE_MAX_CELLS  ) rep->cells = SPRITE_MAX_CELLS;
+        rep->empty = rep->cells - count_bits(sprite->occupied, rep->cells);
+    }
+    else
+    { // Rects from the layout: a cell is a frame (trimmed to 0x0 if empty)
+        rep->cells = sprite->framecnt;
+        for( int f=0; f<sprite->framecnt; f++ ) rep->empty += (sprite->frame_rect[f].w == 0);
+    }
+    int dup[SPRITE_MAX_FRAMES];
+    if(  (sprite->framecnt > 0) && (atlas_find_duplicates(&sprite, &surf, 1, dup) < 0)  )
+    { // Out of memory (message is printed) : count no duplicates
+        for( int f=0; f<sprite->framecnt; f++ ) dup[f] = -1;
+    }
+
+    long used = 0;                                              // Pixels of visible, unique frames
+    for( int f=0; f<sprite->framecnt; f++ )
+    {
+        const SDL_Rect *r = &sprite->frame_rect[f];
+        if(  r->w == 0  ) continue;                             // Empty frames are not duplicates
+        if(  dup[f] >= 0  ) rep->dups++;
+        SDL_Rect vis = {.x=sprite->frame_offset[f].x, .y=sprite->frame_offset[f].y, .w=r->w, .h=r->h};
+        if(  rep->bbox.w == 0  ) rep->bbox = vis;
+        else SDL_UnionRect(&rep->bbox, &vis, &rep->bbox);
+        if(  dup[f] < 0  ) used += (long)r->w*r->h;
+    }
+    long area = (long)surf->w*surf->h;
+    rep->wasted = (area > 0) ? 100.0f*(area - used)/area : 0;
+    SDL_FreeSurface(surf);
+}
+
+int audit_worker(void *data)
+{ // Take the next sheet until there are none left
+    AuditJob *job = data;
+    Sprite *sprite = calloc(1, sizeof(Sprite));                 // Sprite is big: keep off the stack
+    if(  sprite == NULL  ) return -1;
+    for( int i; (i = SDL_AtomicAdd(&job->next, 1)) < job->n; )
+    {
+        audit_sheet(&job->reports[i], sprite);
+        free(sprite->mask);                                     // Not audited
+        sprite->mask = NULL;
+    }
+    free(sprite);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *art_dir = (argc>1) ? argv[1] : "art";
+    const char *out_path = (argc>2) ? argv[2] : "audit.tsv";
+    int nthreads = (argc>3) ? atoi(argv[3]) : SDL_GetCPUCount();
+    if(  nthreads < 1  ) nthreads = 1;
+    if(  nthreads > AUDIT_MAX_THREADS  ) nthreads = AUDIT_MAX_THREADS;
+
+    AuditJob job = {0};
+    int cap = 0;
+    { // List the .png files
+        DIR *dir = opendir(art_dir);
+        if(  dir == NULL  )
+        {
+            printf("Cannot open folder \"%s\"\n", art_dir);
+            return EXIT_FAILURE;
+        }
+        struct dirent *entry;
+        while(  (entry = readdir(dir)) != NULL  )
+        {
+            if(  is_png(entry->d_name) == false  ) continue;
+            if(  job.n == cap  )
+            {
+                cap = (cap > 0) ? 2*cap : 64;
+                SheetReport *p = realloc(job.reports, cap*sizeof(SheetReport));
+                if(  p == NULL  ) { puts("Out of memory"); closedir(dir); free(job.reports); return EXIT_FAILURE; }
+                job.reports = p;
+            }
+            SheetReport *rep = &job.reports[job.n];
+            *rep = (SheetReport){.status="error"};
+            int len = snprintf(rep->path, AUDIT_PATH_LEN, "%s/%s", art_dir, entry->d_name);
+            if(  len >= AUDIT_PATH_LEN  )
+            {
+                printf("Skipping \"%s/%s\": path is longer than %d characters\n",
+                       art_dir, entry->d_name, AUDIT_PATH_LEN-1);
+                continue;
+            }
+            job.n++;
+        }
+        closedir(dir);
+        if(  job.n > 0  ) qsort(job.reports, job.n, sizeof(SheetReport), compare_names);
+    }
+
+    IMG_Init(IMG_INIT_PNG);
+    { // Scan on nthreads threads (this one included)
+        SDL_Thread *thread[AUDIT_MAX_THREADS];
+        int nstarted = 0;
+        for( int t=1; (t<nthreads) && (t<job.n); t++ )
+        {
+            thread[nstarted] = SDL_CreateThread(audit_worker, "audit", &job);
+            if(  thread[nstarted] == NULL  ) break;             // Fewer threads, same result
+            nstarted++;
+        }
+        audit_worker(&job);
+        for( int t=0; t<nstarted; t++ ) SDL_WaitThread(thread[t], NULL);
+        nthreads = nstarted + 1;                                // Threads that ran
+    }
+
+    int ret = EXIT_FAILURE;
+    FILE *f = fopen(out_path, "w");
+    if(  f == NULL  ) printf("Cannot write \"%s\"\n", out_path);
+    else
+    { // Table
+        fprintf(f, "path\tstatus\tsheet_w\tsheet_h\ttransparent\tframe_w\tframe_h\tframes\tcells\tempty\tdups\t"
+                   "bbox_x\tbbox_y\tbbox_w\tbbox_h\twasted\n");
+        for( int i=0; i<job.n; i++ )
+        {
+            const SheetReport *r = &job.reports[i];
+            fprintf(f, "%s\t%s\t%d\t%d\t%.1f\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%.1f\n",
+                    r->path, r->status, r->sheet_w, r->sheet_h, r->transparent, r->frame_w, r->frame_h,
+                    r->frames, r->cells, r->empty, r->dups, r->bbox.x, r->bbox.y, r->bbox.w, r->bbox.h, r->wasted);
+        }
+        if(  fclose(f) == 0  )
+        {
+            printf("Audited %d sprite sheets on %d threads into \"%s\"\n", job.n, nthreads, out_path);
+            ret = EXIT_SUCCESS;
+        }
+        else printf("Cannot write \"%s\"\n", out_path);
+    }
+
+    // Shutdown
+    free(job.reports);
+    IMG_Quit();
+    SDL_Quit();
+    return ret;
+}
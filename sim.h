@@ -0,0 +1,251 @@
+#ifndef __SIM_H__
+#define __SIM_H__
+/* *************Simulation thread***************
+ * Run anims_tick() on its own thread, so a slow present or a slow
+ * text rasterization does not hold up the simulation.
+ *
+ * The simulation thread owns the AnimSystem. It never reads a Sprite:
+ * the main thread rewrites sheets when they reload (assets.h). It
+ * ticks PACING_SIM_HZ times per second (its own Pacing) and publishes
+ * a copy of the AnimSystem after each tick. The main thread (events,
+ * render, the SDL_Renderer) never touches the simulated AnimSystem:
+ *
+ *  - Main to simulation: sim_send() queues a command (set a clip and
+ *    velocity, place, step a frame) in a ring buffer. One writer, one
+ *    reader, so the head and tail are atomics and no lock is needed.
+ *  - A reloaded sheet's timing (an AnimClip, about 1 KB) is too big
+ *    for a command. sim_sprite_changed() copies it to the clip's
+ *    staging slot, pending[c], then bumps pending_seq[c]. Each tick the
+ *    thread takes the slots whose sequence moved and sets taken_seq[c].
+ *    The main thread only rewrites a slot the thread has taken (it
+ *    waits otherwise, a sheet reload is rare).
+ *  - Simulation to main: a triple buffer of snapshots. The thread
+ *    writes the back snapshot, then swaps it with the middle one
+ *    (one atomic exchange). sim_acquire() swaps the front snapshot
+ *    with the middle one if it is newer. Neither side waits: the
+ *    main thread draws the newest finished snapshot, and the thread
+ *    always has a snapshot to write.
+ *
+ * Without a thread (sim_start not called, or it failed), sim_send()
+ * applies the command at once and the caller ticks sim->anims itself,
+ * as before. Record and replay (record.h) stay single-threaded: the
+ * ticks per frame must come from the log.
+ *
+ * Example:
+ *      Sim sim; sim_init(&sim, &anims);
+ *      sim_start(&sim);                                // -1 : stays single-threaded
+ *      while(  quit == false  )
+ *      {
+ *          sim_send(&sim, (SimCmd){.type=SIM_CONTROL, .i=penguin, .clip=clip, .dir=dir, .vx=vx});
+ *          if(  sim.thread == NULL  ) { ... anims_tick(&anims) per tick ... }
+ *          float alpha = sim_acquire(&sim);            // Threaded : alpha of the newest snapshot
+ *          anims_draw(sim.view, &batch, alpha);
+ *      }
+ *      sim_stop(&sim);                                 // anims belongs to the caller again
+ * *******************************/
+#include <stdlib.h>
+#include <stdbool.h>
+#include <SDL.h>
+#include "pacing.h"
+#include "anims.h"
+
+#define SIM_QUEUE_LEN 64                // Commands in flight, more : sim_send waits
+#define SIM_QUEUE_WRAP (2*SIM_QUEUE_LEN)  // Head and tail count modulo this (full and empty differ)
+#define SIM_NEW 4                       // Flag in middle : published, not taken by sim_acquire yet
+#define SIM_INDEX 3                     // Mask in middle : snapshot index
+
+typedef enum
+{
+    SIM_CONTROL,                        // Instance i plays clip, faces dir, moves vx per tick
+    SIM_PLACE,                          // Move instance i to x,y
+    SIM_STEP_FRAME                      // Instance i goes step frames forward (1) or back (-1)
+} SimCmdType;
+
+typedef struct
+{
+    SimCmdType type;
+    int i;                              // Instance
+    int clip, dir; float vx;            // SIM_CONTROL
+    float x, y;                         // SIM_PLACE
+    int step;                           // SIM_STEP_FRAME
+} SimCmd;
+
+typedef struct
+{
+    AnimSystem *anims;                  // The simulation. Owned by the thread while it runs.
+    SDL_Thread *thread;                 // NULL : single-threaded
+    SDL_atomic_t quit;
+    Pacing pacing;                      // The thread's clock
+    // Commands: main thread to simulation
+    SimCmd cmd[SIM_QUEUE_LEN];
+    SDL_atomic_t head;                  // Next command to write (main thread)
+    SDL_atomic_t tail;                  // Next command to read (simulation)
+    // Reloaded clip timing: main thread to simulation
+    AnimClip *pending;                  // pending[c] : new timing of clip c (heap, threaded only)
+    SDL_atomic_t pending_seq[ANIMS_MAX_CLIPS]; // Bumped by the main thread after writing pending[c]
+    SDL_atomic_t taken_seq[ANIMS_MAX_CLIPS];   // Set by the simulation after copying pending[c]
+    // Snapshots: simulation to main thread
+    AnimSystem snap[3];
+    Uint64 snap_time[3];                // Performance counter at the snapshot's last tick
+    int back;                           // Written by the simulation
+    SDL_atomic_t middle;                // Last published : index | SIM_NEW
+    int front;                          // Read by the main thread
+    const AnimSystem *view;             // What to draw : snap[front], or anims if single-threaded
+} Sim;
+
+void sim_init(Sim *sim, AnimSystem *anims)
+{ // Single-threaded until sim_start
+    SDL_zerop(sim);
+    sim->anims = anims;
+    sim->view = anims;
+}
+
+void sim_apply(AnimSystem *anims, const SimCmd *cmd)
+{
+    switch(  cmd->type  )
+    {
+        case SIM_CONTROL:
+            anims_set_clip(anims, cmd->i, cmd->clip);
+            anims->dir[cmd->i] = cmd->dir;
+            anims->vx[cmd->i] = cmd->vx;
+            break;
+        case SIM_PLACE: anims_place(anims, cmd->i, cmd->x, cmd->y); break;
+        case SIM_STEP_FRAME: anims_step_frame(anims, cmd->i, cmd->step); break;
+    }
+}
+
+void sim_send(Sim *sim, SimCmd cmd)
+{ // Single-threaded : apply cmd now. Threaded : queue it for the next tick.
+    if(  sim->thread == NULL  ) { sim_apply(sim->anims, &cmd); return; }
+    int head = SDL_AtomicGet(&sim->head);
+    while(  (head - SDL_AtomicGet(&sim->tail) + SIM_QUEUE_WRAP) % SIM_QUEUE_WRAP == SIM_QUEUE_LEN  )
+    { // Full : the thread is behind
+        SDL_Delay(1);
+    }
+    sim->cmd[head % SIM_QUEUE_LEN] = cmd;
+    SDL_AtomicSet(&sim->head, (head + 1) % SIM_QUEUE_WRAP);     // Publish (SDL atomics are full barriers)
+}
+
+void sim_sprite_changed(Sim *sim, const Sprite *sprite)
+{ // Main thread : sprite was (re)loaded. Hand a copy of its timing to every clip playing it.
+    const AnimSystem *anims = sim->anims;                       // clips[] and nclips are not written by the thread
+    for( int c=0; c<anims->nclips; c++ )
+    {
+        if(  anims->clips[c] != sprite  ) continue;
+        if(  sim->thread == NULL  )
+        {
+            AnimClip timing;
+            anims_clip_from_sprite(&timing, sprite);
+            anims_clip_changed(sim->anims, c, &timing);
+            continue;
+        }
+        int seq = SDL_AtomicGet(&sim->pending_seq[c]);
+        while(  SDL_AtomicGet(&sim->taken_seq[c]) != seq  )
+        { // The thread has not taken the last reload of this clip yet
+            SDL_Delay(1);
+        }
+        anims_clip_from_sprite(&sim->pending[c], sprite);
+        SDL_AtomicSet(&sim->pending_seq[c], seq + 1);           // Publish (SDL atomics are full barriers)
+    }
+}
+
+bool sim_receive(Sim *sim)
+{ // Simulation thread : apply every queued command and reloaded clip. Return false if there was none.
+    bool changed = false;
+    for( int c=0; c<sim->anims->nclips; c++ )
+    {
+        int seq = SDL_AtomicGet(&sim->pending_seq[c]);
+        if(  SDL_AtomicGet(&sim->taken_seq[c]) == seq  ) continue;
+        anims_clip_changed(sim->anims, c, &sim->pending[c]);
+        SDL_AtomicSet(&sim->taken_seq[c], seq);                 // Free the slot
+        changed = true;
+    }
+    int tail = SDL_AtomicGet(&sim->tail);
+    int head = SDL_AtomicGet(&sim->head);
+    if(  tail == head  ) return changed;
+    for( ; tail != head; tail = (tail + 1) % SIM_QUEUE_WRAP ) sim_apply(sim->anims, &sim->cmd[tail % SIM_QUEUE_LEN]);
+    SDL_AtomicSet(&sim->tail, tail);                            // Free the slots
+    return true;
+}
+
+void sim_publish(Sim *sim)
+{ // Simulation thread : copy anims to the back snapshot and make it the newest
+    if(  anims_copy(&sim->snap[sim->back], sim->anims) < 0  ) return; // Out of memory : keep the last one
+    const Pacing *p = &sim->pacing;
+    sim->snap_time[sim->back] = p->frame_start - (Uint64)(p->accum*p->freq);
+    sim->back = SDL_AtomicSet(&sim->middle, sim->back | SIM_NEW) & SIM_INDEX;
+}
+
+int sim_thread(void *data)
+{
+    Sim *sim = data;
+    while(  SDL_AtomicGet(&sim->quit) == 0  )
+    {
+        pacing_begin_frame(&sim->pacing);
+        bool changed = sim_receive(sim);
+        while(  pacing_step(&sim->pacing)  ) { anims_tick(sim->anims); changed = true; }
+        if(  changed  ) sim_publish(sim);
+        SDL_Delay(pacing_ms_until(&sim->pacing, 1));            // Sleep to the next tick
+    }
+    return 0;
+}
+
+int sim_start(Sim *sim)
+{ // Tick anims on a new thread. Add every clip before. Return -1 if it cannot (stays single-threaded).
+    sim->pending = calloc((sim->anims->nclips > 0) ? sim->anims->nclips : 1, sizeof(AnimClip));
+    if(  sim->pending == NULL  )
+    {
+        puts("Cannot allocate simulation clips: simulating on the main thread");
+        return -1;
+    }
+    for( int s=0; s<3; s++ )
+    {
+        if(  anims_copy(&sim->snap[s], sim->anims) < 0  )
+        {
+            puts("Cannot allocate simulation snapshots: simulating on the main thread");
+            return -1;
+        }
+    }
+    sim->back = 0; SDL_AtomicSet(&sim->middle, 1); sim->front = 2;
+    sim->view = &sim->snap[sim->front];
+    pacing_init_sim(&sim->pacing);
+    for( int s=0; s<3; s++ ) sim->snap_time[s] = sim->pacing.frame_start;
+    SDL_AtomicSet(&sim->quit, 0);
+    SDL_AtomicSet(&sim->head, 0); SDL_AtomicSet(&sim->tail, 0);
+    for( int c=0; c<ANIMS_MAX_CLIPS; c++ ) { SDL_AtomicSet(&sim->pending_seq[c], 0); SDL_AtomicSet(&sim->taken_seq[c], 0); }
+    sim->thread = SDL_CreateThread(sim_thread, "sim", sim);
+    if(  sim->thread == NULL  )
+    {
+        printf("Cannot start the simulation thread: %s\n", SDL_GetError());
+        sim->view = sim->anims;
+        return -1;
+    }
+    return 0;
+}
+
+float sim_acquire(Sim *sim)
+{ // Threaded : draw the newest snapshot (sim->view). Return how far real time is past its last tick (0 to 1).
+    if(  sim->thread == NULL  ) return 0;
+    if(  SDL_AtomicGet(&sim->middle) & SIM_NEW  ) sim->front = SDL_AtomicSet(&sim->middle, sim->front) & SIM_INDEX;
+    sim->view = &sim->snap[sim->front];
+    const Pacing *p = &sim->pacing;                             // freq and dt do not change
+    double since = pacing_seconds(p, sim->snap_time[sim->front], SDL_GetPerformanceCounter());
+    float alpha = (float)(since/p->dt);
+    return (alpha < 0) ? 0 : (alpha > 1) ? 1 : alpha;
+}
+
+void sim_stop(Sim *sim)
+{ // Stop the thread (if any). sim->anims belongs to the caller again.
+    if(  sim->thread != NULL  )
+    {
+        SDL_AtomicSet(&sim->quit, 1);
+        SDL_WaitThread(sim->thread, NULL);
+        sim->thread = NULL;
+        sim_receive(sim);                                       // Commands sent after the last tick
+    }
+    for( int s=0; s<3; s++ ) anims_free(&sim->snap[s]);
+    free(sim->pending); sim->pending = NULL;
+    sim->view = sim->anims;
+}
+
+#endif // __SIM_H__
@@ -1,19 +1,42 @@
 #ifndef __SPRITE_H__
 #define __SPRITE_H__
 
+#include <stdlib.h>
+#include <string.h>
 #include <SDL.h>
 #include <SDL_image.h>
+#include "layout.h"
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define SPRITE_MAX_CELLS 1024           // Max cells in a sprite sheet, e.g., 8 columns x 128 rows
+#define SPRITE_MAX_FRAMES LAYOUT_MAX_FRAMES // Max frames in one animation
 
 typedef struct
 {
     const char *path;                   // Path to sprite sheet
-    int size;                           // Detect from sprite sheet : Ex: 64x64
+    SDL_Texture *tex;                   // Sprite sheet pixels, uploaded once
+    bool shared_tex;                    // tex belongs to an Atlas, do not destroy it
+    int sheet_w, sheet_h;               // Detect from sprite sheet : Ex: 512x128
+    int frame_w, frame_h;               // Detect from sprite sheet or layout : Ex: 64x64
+    int size;                           // Larger of frame_w and frame_h
     int framecnt;                       // Detect from sprite sheet : Ex: 8 frames
     int framenum;                       // Current frame number : 1 to framecnt
     int scale;                          // Scale sprite by this amount
     SDL_Rect render;                    // Determines size and location of rendered sprite
     SDL_Rect frame;                     // Selects frame (from sprite sheet) to render
     int ticks_per_frame;                // How many game loop ticks before switching to next frame
+    int cols, rows;                     // Detect from sprite sheet : Ex: 8x2 cells
+    uint32_t occupied[SPRITE_MAX_CELLS/32]; // Detect from sprite sheet : 1 bit per non-empty cell
+    SDL_Rect frame_rect[SPRITE_MAX_FRAMES]; // Where frame n is in tex : frame_rect[n-1], trimmed to its visible pixels
+    SDL_Point frame_offset[SPRITE_MAX_FRAMES]; // Pivot : where frame_rect[n-1] sits in the frame_w x frame_h frame
+    bool has_durations;                 // Layout gives frame_ms[], else every frame lasts ticks_per_frame
+    int frame_ms[SPRITE_MAX_FRAMES];    // How long frame n shows : frame_ms[n-1], 0 : ticks_per_frame
+    uint64_t *mask;                     // 1 bit per pixel of every frame_rect (see sprite_build_masks), NULL : none
+    int mask_at[SPRITE_MAX_FRAMES];     // Frame n's mask starts at mask[mask_at[n-1]]
 } Sprite;
 
 bool sprite_sheet_has_transparency(SDL_Surface *sprite_surf, const char *sprite_path)
@@ -21,7 +44,7 @@ bool sprite_sheet_has_transparency(SDL_Surface *sprite_surf, const char *sprite_
     uint32_t *p = sprite_surf->pixels;
     if(  *p != 0x00000000  )
     { // Top-left pixel in image is not 0 -- background is not transparent
-        printf("Sprite sheet \"%s\" does not have a transparent background.", sprite_path);
+        printf("Sprite sheet \"%s\" does not have a transparent background.\n", sprite_path);
         return false;
     }
     return true;
@@ -30,96 +53,383 @@ bool sprite_sheet_has_transparency(SDL_Surface *sprite_surf, const char *sprite_
 int sprite_get_size(SDL_Surface *sprite_surf)
 { // Return size : e.g., 64 for a 64x64
     /* *************DOC***************
-     * - Sprites are always square, so a single number is enough to represent size
-     * - Sprite sheet must have eight sprite frames per row
+     * Default layout only (no descriptor, see layout.h):
+     * - Sprites are square, so a single number is enough to represent size
+     * - Sprite sheet has eight sprite frames per row
      * *******************************/
     return sprite_surf->w/8;                                    // e.g., 512/8 = 64
 }
 
-int sprite_get_num_frames(SDL_Surface *sprite_surf, int sprite_size)
-{ // Return number of frames in the spritesheet
+uint32_t sprite_or_span(const uint32_t *p, int n)
+{ // Return the bitwise OR of n pixels
+    /* *************DOC***************
+     * OR instead of SUM: a sum of uint32_t pixels can wrap to 0 and
+     * make a full frame look empty. An OR is only 0 if every pixel is 0.
+     *
+     * Vector width is picked at compile time (e.g., CFLAGS += -mavx2).
+     * x86-64 always has SSE2. Other targets use the scalar loop.
+     * *******************************/
+    uint32_t acc = 0;
+    int i = 0;
+#if defined(__AVX2__)
+    __m256i v8 = _mm256_setzero_si256();
+    for( ; i+8 <= n; i+=8 ) v8 = _mm256_or_si256(v8, _mm256_loadu_si256((const __m256i *)(p+i)));
+    __m128i v = _mm_or_si128(_mm256_castsi256_si128(v8), _mm256_extracti128_si256(v8, 1));
+#elif defined(__SSE2__)
+    __m128i v = _mm_setzero_si128();
+    for( ; i+4 <= n; i+=4 ) v = _mm_or_si128(v, _mm_loadu_si128((const __m128i *)(p+i)));
+#endif
+#if defined(__AVX2__) || defined(__SSE2__)
+    v = _mm_or_si128(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1,0,3,2)));  // Fold 4 lanes to 2
+    v = _mm_or_si128(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2,3,0,1)));  // Fold 2 lanes to 1
+    acc = (uint32_t)_mm_cvtsi128_si32(v);
+#endif
+    for( ; i<n; i++ ) acc |= p[i];                              // Leftover pixels
+    return acc;
+}
+
+bool sprite_cell_is_empty(SDL_Surface *sprite_surf, int x, int y, int w, int h)
+{ // Return true if every pixel in the cell has alpha 0
     /* *************DOC***************
-     * Determine number of frames by counting the number of non-empty frames.
-     * The count ends with the first empty frame.
-     * An empty frame has the value 0 for all pixels.
+     * Surface must be 32-bit.
+     * If the surface has no alpha channel, a cell is empty if every pixel is 0.
      * *******************************/
-    int sprite_framecnt = 0;
-    printf("sprite_surf->\n\t%dx%d (wxh)\n\tpitch: %d\n", sprite_surf->w, sprite_surf->h, sprite_surf->pitch);
-    printf("sprite_surf->format->\n\tBytesPerPixel: %d\n", sprite_surf->format->BytesPerPixel);
-    fflush(stdout);
-    // Each pixel is 4 bytes
-    // Each row is 512 pixels (2048 bytes)
-    bool found_empty_frame = false;
-    int cstart = 0; int rstart = 0;
-    int cstop = sprite_size; int rstop = sprite_size;
-    uint32_t sum = 0;                                           // Sum pixel values
-    uint32_t *p = sprite_surf->pixels;                          // Walk the pixels
-    uint32_t *prow;                                             // Point at first pixel in the row
-    uint32_t *p0 = sprite_surf->pixels;                         // Point at first pixel in the image
-    while( found_empty_frame == false)
+    uint32_t amask = sprite_surf->format->Amask;
+    if(  amask == 0  ) amask = 0xFFFFFFFF;
+    const uint8_t *p0 = (const uint8_t *)sprite_surf->pixels;  // Rows are pitch bytes apart
+    for( int r=y; r<y+h; r++ )
     {
-        for( int r=rstart; r<rstop; r++)
-        {
-            prow = p0 + r*sprite_surf->w;                       // prow : point at col 0 in this row
-            for( int c=cstart; c<cstop; c++)
-            {
-                sum += *p;                                      // Accumulate
-                p = prow + c;                                   // Advance to next column
-            }
-        }
-        if(  sum == 0  ) found_empty_frame = true;              // Found an empty frame. Count is done.
-        else
-        {
-            sprite_framecnt += 1;                               // Frame not empty. Count it.
-            sum = 0;                                            // Reset the sum.
-            cstart += sprite_size;                              // Advance to next frame.
-            if(  cstart >= sprite_surf->w  )                    // If this is the end of the row
-            {
-                cstart = 0;                                     // Go back to column 0
-                rstart += sprite_size;                          // and go to next row
-                rstop = rstart + sprite_size;
-            }
-            cstop = cstart + sprite_size;
-        }
-        // If number of frames is a multiple of 8, there are no empty frames.
-        // Instead, look for when the row goes past the bottom of the spritesheet.
-        if(  rstart >= sprite_surf->h  ) found_empty_frame = true;
+        const uint32_t *prow = (const uint32_t *)(p0 + r*sprite_surf->pitch) + x;
+        if(  sprite_or_span(prow, w) & amask  ) return false;  // Stop at first visible pixel
+    }
+    return true;
+}
+
+int sprite_scan_grid(SDL_Surface *sprite_surf, const SpriteLayout *grid,
+                     uint32_t *occupied, int *cols, int *rows)
+{ // Fill bitmap occupied with one bit per cell of the grid. Return the number of non-empty cells.
+    /* *************DOC***************
+     * grid : frame_w x frame_h cells, margin and spacing in pixels,
+     *        at most grid->cols x grid->rows cells (0 : as many as fit)
+     *
+     * Cells are numbered in reading order: cell = row*cols + col.
+     * Bit (cell%32) of occupied[cell/32] is 1 if the cell is not empty.
+     * occupied must have room for SPRITE_MAX_CELLS bits.
+     * Partial cells at the right and bottom edge are ignored.
+     * *******************************/
+    memset(occupied, 0, SPRITE_MAX_CELLS/8);
+    *cols = 0; *rows = 0;
+    int cell_w = grid->frame_w; int cell_h = grid->frame_h;
+    int step_x = cell_w + grid->spacing; int step_y = cell_h + grid->spacing;
+    if(  (cell_w <= 0) || (cell_h <= 0)  ) return 0;            // Sheet too small for 8 columns
+    if(  (grid->margin < 0) || (grid->spacing < 0)  ) return 0; // Bad layout (layout_load rejects it)
+    *cols = (sprite_surf->w - 2*grid->margin + grid->spacing)/step_x;
+    *rows = (sprite_surf->h - 2*grid->margin + grid->spacing)/step_y;
+    if(  *cols < 0  ) *cols = 0;
+    if(  *rows < 0  ) *rows = 0;
+    if(  (grid->cols > 0) && (grid->cols < *cols)  ) *cols = grid->cols;
+    if(  (grid->rows > 0) && (grid->rows < *rows)  ) *rows = grid->rows;
+    int ncells = (*cols)*(*rows);
+    if(  ncells > SPRITE_MAX_CELLS  )
+    {
+        printf("Sprite sheet has %d cells. Only scanning the first %d.\n", ncells, SPRITE_MAX_CELLS);
+        ncells = SPRITE_MAX_CELLS;
+    }
+    int count = 0;
+    for( int cell=0; cell<ncells; cell++ )
+    {
+        int x = grid->margin + (cell % *cols)*step_x;
+        int y = grid->margin + (cell / *cols)*step_y;
+        if(  sprite_cell_is_empty(sprite_surf, x, y, cell_w, cell_h)  ) continue;
+        occupied[cell/32] |= 1u << (cell%32);
+        count++;
+    }
+    return count;
+}
+
+int sprite_scan_occupancy(SDL_Surface *sprite_surf, int sprite_size,
+                          uint32_t *occupied, int *cols, int *rows)
+{ // Same as sprite_scan_grid for a grid of square cells with no margin or spacing
+    SpriteLayout grid = {.frame_w=sprite_size, .frame_h=sprite_size};
+    return sprite_scan_grid(sprite_surf, &grid, occupied, cols, rows);
+}
+
+bool sprite_cell_occupied(const Sprite *sprite, int cell)
+{ // Return true if cell (numbered in reading order) has pixels
+    if(  (cell < 0) || (cell >= sprite->cols*sprite->rows) || (cell >= SPRITE_MAX_CELLS)  ) return false;
+    return (sprite->occupied[cell/32] >> (cell%32)) & 1u;
+}
+
+bool sprite_trim_rect(SDL_Surface *sprite_surf, SDL_Rect *rect, SDL_Point *offset)
+{ // Shrink rect to the bounding box of its visible pixels and add the cut to offset. Return false if empty.
+    /* *************DOC***************
+     * Same pixel walk as sprite_cell_is_empty: whole rows at a time
+     * (sprite_or_span) from the top and from the bottom, then only
+     * the rows left are walked from each side for the columns.
+     * An empty frame becomes a 0x0 rect (nothing is drawn).
+     * *******************************/
+    uint32_t amask = sprite_surf->format->Amask;
+    if(  amask == 0  ) amask = 0xFFFFFFFF;
+    const uint8_t *p0 = (const uint8_t *)sprite_surf->pixels;  // Rows are pitch bytes apart
+    #define SPRITE_ROW(r) ((const uint32_t *)(p0 + (r)*sprite_surf->pitch) + rect->x)
+    int top = rect->y; int bottom = rect->y + rect->h - 1;
+    while(  (top <= bottom) && ((sprite_or_span(SPRITE_ROW(top), rect->w) & amask) == 0)  ) top++;
+    if(  top > bottom  )
+    { // No visible pixels
+        rect->w = 0; rect->h = 0;
+        return false;
+    }
+    while(  (sprite_or_span(SPRITE_ROW(bottom), rect->w) & amask) == 0  ) bottom--;
+    int left = rect->w; int right = -1;
+    for( int r=top; r<=bottom; r++ )
+    { // Only look past the bounds found so far
+        const uint32_t *p = SPRITE_ROW(r);
+        int x = 0;
+        while(  (x < left) && ((p[x] & amask) == 0)  ) x++;
+        if(  x < left  ) left = x;
+        x = rect->w - 1;
+        while(  (x > right) && ((p[x] & amask) == 0)  ) x--;
+        if(  x > right  ) right = x;
     }
-    return sprite_framecnt;
+    #undef SPRITE_ROW
+    offset->x += left; offset->y += top - rect->y;
+    *rect = (SDL_Rect){.x=rect->x + left, .y=top, .w=right - left + 1, .h=bottom - top + 1};
+    return true;
+}
+
+int sprite_count_leading_frames(const uint32_t *occupied, int ncells)
+{ // Return number of non-empty cells before the first empty cell
+    int cnt = 0;
+    if(  ncells > SPRITE_MAX_CELLS  ) ncells = SPRITE_MAX_CELLS;
+    while(  (cnt < ncells) && ((occupied[cnt/32] >> (cnt%32)) & 1u)  ) cnt++;
+    return cnt;
 }
 
-int sprite_load_info(Sprite *sprite)
-{ // Auto-detect sprite size and number of frames of animation
-    // Load spritesheet into a Surface to check transparency, size, and number of frames
-    SDL_Surface *sprite_surf = IMG_Load(sprite->path);
+SDL_Surface *sprite_decode_surface(const char *sprite_path)
+{ // Decode the png into a 32-bit Surface, whatever its pixels are. Return NULL on error.
+    SDL_Surface *sprite_surf = IMG_Load(sprite_path);
     if(  sprite_surf == NULL  )
     { // Unable to load image
-        printf("Failed to load \"%s\": %s", sprite->path, IMG_GetError());
-        return -1;
+        printf("Failed to load \"%s\": %s\n", sprite_path, IMG_GetError());
+        return NULL;
+    }
+    if(  sprite_surf->format->BytesPerPixel != 4  )
+    { // Scanner walks 32-bit pixels
+        SDL_Surface *surf32 = SDL_ConvertSurfaceFormat(sprite_surf, SDL_PIXELFORMAT_ARGB8888, 0);
+        SDL_FreeSurface(sprite_surf);
+        if(  surf32 == NULL  )
+        {
+            printf("Failed to convert \"%s\": %s\n", sprite_path, SDL_GetError());
+            return NULL;
+        }
+        sprite_surf = surf32;
     }
-    if(  sprite_sheet_has_transparency(sprite_surf, sprite->path) == false )
+    return sprite_surf;
+}
+
+SDL_Surface *sprite_load_surface(const char *sprite_path)
+{ // Decode the sprite sheet into a 32-bit Surface. Return NULL on error.
+    SDL_Surface *sprite_surf = sprite_decode_surface(sprite_path);
+    if(  sprite_surf == NULL  ) return NULL;
+    if(  sprite_sheet_has_transparency(sprite_surf, sprite_path) == false )
     { // Sprite sheet does not have a transparent background
         SDL_FreeSurface(sprite_surf);
+        return NULL;
+    }
+    return sprite_surf;
+}
+
+int sprite_mask_words(const Sprite *sprite, int f)
+{ // Words per mask row of frame f (0-based)
+    return (sprite->frame_rect[f].w > 0) ? (sprite->frame_rect[f].w + 63)/64 : 0;
+}
+
+int sprite_build_masks(Sprite *sprite, const void *pixels, int pitch, int w, int h, uint32_t amask)
+{ // Keep a 1-bit alpha mask of every frame. Return -1 if out of memory (sprite->mask is NULL).
+    /* *************DOC***************
+     * pixels : w x h 32-bit pixels the frame rects point into (the
+     *          sheet, or a baked atlas), rows are pitch bytes apart.
+     *          Parts of a rect outside w x h are transparent.
+     * amask  : alpha bits of a pixel (0 : a pixel is visible if not 0)
+     *
+     * Frame f's mask is frame_rect[f].h rows of sprite_mask_words()
+     * words, starting at mask[mask_at[f]]. Pixel x of a row is bit
+     * (x%64) of word x/64: 1 if its alpha is not 0. Bits past the
+     * right edge are 0. The rects are already trimmed, so the masks
+     * only cover visible pixels, wherever the frame is packed later.
+     *
+     * All frames share one allocation. See collide.h.
+     * *******************************/
+    free(sprite->mask);
+    sprite->mask = NULL;
+    if(  amask == 0  ) amask = 0xFFFFFFFF;
+    size_t nwords = 0;
+    for( int f=0; f<sprite->framecnt; f++ )
+    {
+        sprite->mask_at[f] = (int)nwords;
+        if(  sprite->frame_rect[f].h > 0  ) nwords += (size_t)sprite->frame_rect[f].h*sprite_mask_words(sprite, f);
+    }
+    if(  nwords == 0  ) return 0;                               // Every frame is empty
+    uint64_t *mask = calloc(nwords, sizeof(uint64_t));
+    if(  mask == NULL  )
+    {
+        printf("Out of memory for the masks of \"%s\"\n", sprite->path);
         return -1;
     }
-    sprite->size = sprite_get_size(sprite_surf);            // Determine size of sprite
-    sprite->framecnt = 0;                                   // Determine number of frames in animation
-    sprite->framecnt = sprite_get_num_frames(sprite_surf, sprite->size);
-    SDL_FreeSurface(sprite_surf);
+    for( int f=0; f<sprite->framecnt; f++ )
+    {
+        const SDL_Rect *r = &sprite->frame_rect[f];
+        int words = sprite_mask_words(sprite, f);
+        int x0 = (r->x < 0) ? -r->x : 0; int x1 = (r->x + r->w > w) ? w - r->x : r->w;
+        for( int y=0; y<r->h; y++ )
+        {
+            if(  (r->y + y < 0) || (r->y + y >= h)  ) continue;
+            const uint32_t *p = (const uint32_t *)((const uint8_t *)pixels + (size_t)(r->y + y)*pitch) + r->x;
+            uint64_t *row = mask + sprite->mask_at[f] + y*words;
+            for( int x=x0; x<x1; x++ ) row[x/64] |= (uint64_t)((p[x] & amask) != 0) << (x%64);
+        }
+    }
+    sprite->mask = mask;
+    return 0;
+}
 
-    // Load other values
+void sprite_init_state(Sprite *sprite)
+{ // Animation and render state for a sprite whose info is loaded
     sprite->ticks_per_frame = 3;                            // Stay on each frame for 3 game loop ticks 
     sprite->framenum = 1;                                   // Start animation at first frame
     sprite->scale = 2;                                      // Initial scale is 2x actual size
     sprite->render = (SDL_Rect){.x=0,.y=0,
-                                .w=sprite->scale*sprite->size, // Scale sprite up by 2x
-                                .h=sprite->scale*sprite->size  // Scale sprite up by 2x
+                                .w=sprite->scale*sprite->frame_w, // Scale sprite up by 2x
+                                .h=sprite->scale*sprite->frame_h  // Scale sprite up by 2x
                                 };
     sprite->frame  = (SDL_Rect){.x=0, .y=0,                 // start at first frame
-                                .w=sprite->size, .h=sprite->size // 64x64 sprite
+                                .w=sprite->frame_w, .h=sprite->frame_h // 64x64 sprite
                                 };
+    if(  sprite->framecnt > 0  ) sprite->frame = sprite->frame_rect[0];
+}
+
+void sprite_apply_layout(Sprite *sprite, SDL_Surface *sprite_surf, const SpriteLayout *layout)
+{ // Find the frames of the decoded sheet: explicit rects, or scan the layout's grid
+    /* *************DOC***************
+     * Every frame lookup after this is frame_rect[framenum-1], for
+     * any layout (see anim_load_frame).
+     * frame_rect[] is trimmed to the visible pixels, and
+     * frame_offset[] says where to draw it in the frame_w x frame_h
+     * frame. Fewer transparent pixels are blended at scale 2x or more,
+     * and the atlas packs tighter.
+     * *******************************/
+    sprite->sheet_w = sprite_surf->w;
+    sprite->sheet_h = sprite_surf->h;
+    sprite->frame_w = 0; sprite->frame_h = 0;
+    if(  layout->nrects > 0  )
+    { // Frames are where the JSON says (not a grid)
+        memset(sprite->occupied, 0, sizeof(sprite->occupied));
+        sprite->cols = 0; sprite->rows = 0;
+        sprite->framecnt = (layout->nrects < SPRITE_MAX_FRAMES) ? layout->nrects : SPRITE_MAX_FRAMES;
+        for( int i=0; i<sprite->framecnt; i++ )
+        { // Rects the tool trimmed keep their place in the untrimmed frame
+            const SDL_Rect *src = &layout->source[i];
+            sprite->frame_rect[i] = layout->rect[i];
+            sprite->frame_offset[i] = (SDL_Point){.x=src->x, .y=src->y};
+            int w = (src->w > 0) ? src->w : layout->rect[i].w;
+            int h = (src->h > 0) ? src->h : layout->rect[i].h;
+            if(  w > sprite->frame_w  ) sprite->frame_w = w;
+            if(  h > sprite->frame_h  ) sprite->frame_h = h;
+        }
+    }
+    else
+    { // Grid: frame size from the layout, else square cells in 8 columns
+        SpriteLayout grid = *layout;
+        if(  (grid.frame_w <= 0) && (grid.frame_h <= 0)  ) grid.frame_w = grid.frame_h = sprite_get_size(sprite_surf);
+        else if(  grid.frame_w <= 0  ) grid.frame_w = grid.frame_h;
+        else if(  grid.frame_h <= 0  ) grid.frame_h = grid.frame_w;
+        sprite->frame_w = grid.frame_w; sprite->frame_h = grid.frame_h;
+        sprite_scan_grid(sprite_surf, &grid,                // Find the non-empty cells
+                         sprite->occupied, &sprite->cols, &sprite->rows);
+        int ncells = sprite->cols*sprite->rows;
+        sprite->framecnt = (layout->nframes > 0) ? ((layout->nframes < ncells) ? layout->nframes : ncells)
+                                                 : sprite_count_leading_frames(sprite->occupied, ncells);
+        if(  sprite->framecnt > SPRITE_MAX_FRAMES  ) sprite->framecnt = SPRITE_MAX_FRAMES;
+        for( int i=0; i<sprite->framecnt; i++ )
+        { // Frame rects in the sprite sheet (an Atlas moves them)
+            sprite->frame_rect[i] = (SDL_Rect){.x=grid.margin + (i % sprite->cols)*(grid.frame_w + grid.spacing),
+                                               .y=grid.margin + (i / sprite->cols)*(grid.frame_h + grid.spacing),
+                                               .w=grid.frame_w, .h=grid.frame_h};
+            sprite->frame_offset[i] = (SDL_Point){0};
+        }
+    }
+    SDL_Rect sheet = {.x=0, .y=0, .w=sprite_surf->w, .h=sprite_surf->h};
+    for( int i=0; i<sprite->framecnt; i++ )
+    { // Draw only the visible pixels
+        SDL_Rect *r = &sprite->frame_rect[i];
+        SDL_Rect in;
+        if(  SDL_IntersectRect(r, &sheet, &in) == SDL_FALSE  )
+        { // Layout rect is outside the sheet: empty frame
+            *r = (SDL_Rect){0};
+            continue;
+        }
+        sprite->frame_offset[i].x += in.x - r->x;               // Clip to the sheet, the pivot stays put
+        sprite->frame_offset[i].y += in.y - r->y;
+        *r = in;
+        sprite_trim_rect(sprite_surf, r, &sprite->frame_offset[i]);
+    }
+    sprite_build_masks(sprite, sprite_surf->pixels, sprite_surf->pitch,
+                       sprite_surf->w, sprite_surf->h, sprite_surf->format->Amask);
+    sprite->size = (sprite->frame_w > sprite->frame_h) ? sprite->frame_w : sprite->frame_h;
+    sprite->has_durations = false;
+    for( int i=0; i<sprite->framecnt; i++ )
+    {
+        sprite->frame_ms[i] = (layout->ms[i] > 0) ? layout->ms[i] : layout->duration_ms;
+        if(  sprite->frame_ms[i] > 0  ) sprite->has_durations = true;
+    }
+    sprite_init_state(sprite);
+}
+
+void sprite_load_info(Sprite *sprite, SDL_Surface *sprite_surf)
+{ // Find sprite size and frames of animation: from the layout next to the sheet, else auto-detect
+    SpriteLayout layout;                                    // Default layout if there is no descriptor
+    if(  sprite->path != NULL  ) layout_load(&layout, sprite->path);
+    else layout_default(&layout);
+    sprite_apply_layout(sprite, sprite_surf, &layout);
+}
+
+int sprite_load_texture(Sprite *sprite, SDL_Renderer *ren, SDL_Surface *sprite_surf)
+{ // Upload the decoded sheet to sprite->tex
+    sprite->shared_tex = false;
+    sprite->tex = SDL_CreateTextureFromSurface(ren, sprite_surf);
+    if(  sprite->tex == NULL  )
+    {
+        printf("Failed to create texture for \"%s\": %s\n", sprite->path, SDL_GetError());
+        return -1;
+    }
     return 0;
 }
 
+int sprite_load(Sprite *sprite, SDL_Renderer *ren)
+{ // Decode the sprite sheet once: analyze the pixels, then upload the same pixels
+    /* *************DOC***************
+     * Example:
+     *      Sprite PenguinIdle = {.path = "art/penguin-huff.png"};
+     *      if(  sprite_load(&PenguinIdle, ren) < 0  ) ...
+     *      ...
+     *      sprite_free(&PenguinIdle);
+     * *******************************/
+    SDL_Surface *sprite_surf = sprite_load_surface(sprite->path);
+    if(  sprite_surf == NULL  ) return -1;
+    sprite_load_info(sprite, sprite_surf);
+    int ret = sprite_load_texture(sprite, ren, sprite_surf);
+    SDL_FreeSurface(sprite_surf);
+    return ret;
+}
+
+void sprite_free(Sprite *sprite)
+{
+    if(  sprite == NULL  ) return;
+    if(  sprite->shared_tex == false  ) SDL_DestroyTexture(sprite->tex);
+    sprite->tex = NULL;
+    free(sprite->mask);
+    sprite->mask = NULL;
+}
+
 #endif // __SPRITE_H__
 
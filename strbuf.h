@@ -0,0 +1,148 @@
+#ifndef __STRBUF_H__
+#define __STRBUF_H__
+/* *************String builder***************
+ * Append text to a fixed buffer without overrunning it.
+ *
+ * Example:
+ *      char text[64];
+ *      StrBuf sb; strbuf_init(&sb, text, sizeof(text));
+ *      strbuf_put(&sb, "Frame: ");
+ *      int slot = strbuf_field(&sb, 3);        // 3 characters, filled in later
+ *      strbuf_put(&sb, " ms: "); strbuf_fixed(&sb, 16.67f, 2);
+ *      ...
+ *      strbuf_set_int(&sb, slot, 3, framenum); // Next frame: only rewrite the slot
+ *
+ * The buffer never has more than cap-1 characters and is always '\0'
+ * terminated. Text that does not fit is cut and sb.full is set (until
+ * strbuf_reset).
+ *
+ * Numbers are formatted by hand (no sprintf): a field that changes
+ * every frame is a few divides.
+ * *******************************/
+#include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+
+#define STRBUF_INT_LEN 11               // Longest int: "-2147483648"
+
+typedef struct
+{
+    char *buf;                          // Text, always '\0' terminated
+    int len;                            // Characters in buf
+    int cap;                            // Size of buf (max len is cap-1)
+    bool full;                          // Some text did not fit and was cut
+} StrBuf;
+
+void strbuf_init(StrBuf *sb, char *buf, int cap)
+{
+    sb->buf = buf; sb->cap = cap;
+    sb->len = 0; sb->full = false;
+    if(  cap > 0  ) buf[0] = '\0';
+}
+
+void strbuf_reset(StrBuf *sb)
+{ // Empty the buffer and clear full
+    sb->len = 0; sb->full = false;
+    if(  sb->cap > 0  ) sb->buf[0] = '\0';
+}
+
+void strbuf_truncate(StrBuf *sb, int len)
+{ // Drop everything after the first len characters (full stays set until strbuf_reset)
+    if(  (len < 0) || (len > sb->len)  ) return;
+    sb->len = len;
+    if(  sb->cap > 0  ) sb->buf[len] = '\0';
+}
+
+int strbuf_room(const StrBuf *sb)
+{ // Characters that still fit
+    return (sb->cap > 0) ? sb->cap - 1 - sb->len : 0;
+}
+
+void strbuf_putn(StrBuf *sb, const char *str, int n)
+{ // Append the first n characters of str
+    if(  n > strbuf_room(sb)  ) { n = strbuf_room(sb); sb->full = true; }
+    if(  n <= 0  ) return;
+    memcpy(sb->buf + sb->len, str, n);
+    sb->len += n;
+    sb->buf[sb->len] = '\0';
+}
+
+void strbuf_put(StrBuf *sb, const char *str)
+{
+    strbuf_putn(sb, str, (int)strlen(str));
+}
+
+int strbuf_itoa(char *digits, int val)
+{ // Write val to digits (STRBUF_INT_LEN characters, no '\0'). Return the length.
+    char tmp[STRBUF_INT_LEN];
+    unsigned int u = (val < 0) ? 0u - (unsigned int)val : (unsigned int)val; // INT_MIN too
+    int n = 0;
+    do { tmp[n++] = (char)('0' + u%10); u /= 10; } while(  u > 0  );
+    int len = 0;
+    if(  val < 0  ) digits[len++] = '-';
+    while(  n > 0  ) digits[len++] = tmp[--n];                  // Most significant digit first
+    return len;
+}
+
+void strbuf_int(StrBuf *sb, int val)
+{
+    char digits[STRBUF_INT_LEN];
+    strbuf_putn(sb, digits, strbuf_itoa(digits, val));
+}
+
+void strbuf_fixed(StrBuf *sb, float val, int decimals)
+{ // Append val with decimals digits after the point (0 to 4), e.g., 16.67
+    static const int scale[5] = {1, 10, 100, 1000, 10000};
+    if(  decimals < 0  ) decimals = 0;
+    if(  decimals > 4  ) decimals = 4;
+    float scaled = val*scale[decimals];
+    if(  (scaled != scaled) || (scaled >= (float)INT_MAX) || (scaled <= -(float)INT_MAX)  )
+    { // NaN or too big
+        strbuf_put(sb, "?");
+        return;
+    }
+    int n = (int)((scaled < 0) ? scaled - 0.5f : scaled + 0.5f); // Round half away from 0
+    if(  n < 0  ) { strbuf_put(sb, "-"); n = -n; }
+    strbuf_int(sb, n/scale[decimals]);
+    if(  decimals == 0  ) return;
+    char frac[5] = {'.'};                                       // '.' and up to 4 digits
+    for( int d=decimals, f=n%scale[decimals]; d>0; d-- ) { frac[d] = (char)('0' + f%10); f /= 10; }
+    strbuf_putn(sb, frac, decimals+1);
+}
+
+int strbuf_field(StrBuf *sb, int width)
+{ // Append width spaces for a value to write later. Return where it starts, -1 if it did not fit.
+    if(  width > strbuf_room(sb)  ) { sb->full = true; return -1; }
+    int slot = sb->len;
+    memset(sb->buf + sb->len, ' ', width);
+    sb->len += width;
+    sb->buf[sb->len] = '\0';
+    return slot;
+}
+
+void strbuf_set_str(StrBuf *sb, int slot, int width, const char *str)
+{ // Write str in the field at slot, left aligned. Cut to width.
+    if(  slot < 0  ) return;
+    int n = 0;
+    for( ; (n < width) && (str[n] != '\0'); n++ ) sb->buf[slot+n] = str[n];
+    memset(sb->buf + slot + n, ' ', width - n);
+}
+
+void strbuf_set_int(StrBuf *sb, int slot, int width, int val)
+{ // Write val in the field at slot, right aligned. Too wide for the field: fill it with '*'.
+    if(  slot < 0  ) return;
+    char digits[STRBUF_INT_LEN];
+    int len = strbuf_itoa(digits, val);
+    if(  len > width  ) { memset(sb->buf + slot, '*', width); return; }
+    memset(sb->buf + slot, ' ', width - len);
+    memcpy(sb->buf + slot + width - len, digits, len);
+}
+
+int strbuf_put_int_field(StrBuf *sb, int width, int val)
+{ // Append a field of width and write val in it. Return the slot.
+    int slot = strbuf_field(sb, width);
+    strbuf_set_int(sb, slot, width, val);
+    return slot;
+}
+
+#endif // __STRBUF_H__
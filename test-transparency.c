@@ -6,6 +6,8 @@
  * Pixel in top-left corner is:
  * - 0x00000000 if transparency is preserved
  * - 0xFFFFFFFF if transparency is lost
+ *
+ * To check every sheet in a folder at once, see sheet-audit.c.
  * *******************************/
 #include <SDL.h>
 #include <SDL_image.h>
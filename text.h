@@ -2,6 +2,8 @@
 #define __TEXT_H__
 
 #include <SDL.h>
+#include <SDL_ttf.h>
+#include "font.h"
 typedef struct
 {
     char *text;
@@ -11,7 +13,82 @@ typedef struct
     SDL_Rect bg_rect;
     SDL_Color bg;
     int margin;
+    uint32_t hash;                      // Hash of text (and wrap width) rendered in tex
+    GlyphAtlas *atlas;                  // If not NULL, draw glyphs from atlas instead of tex
+    int wrap;                           // Wrap width used by atlas
 } TextBox;
 
-#endif // __TEXT_H__
+uint32_t text_hash(const char *text, int wrap)
+{ // Return FNV-1a hash of the text and the wrap width
+    uint32_t h = 2166136261u;                                   // FNV offset basis
+    for( const char *c = text; *c != '\0'; c++ )
+    {
+        h ^= (uint8_t)*c;
+        h *= 16777619u;                                         // FNV prime
+    }
+    h ^= (uint32_t)wrap;
+    h *= 16777619u;
+    return h;
+}
+
+void textbox_layout(TextBox *tb)
+{ // Size the background box to the text (textbox_update calls this)
+    tb->bg_rect.h = tb->fg_rect.h + 2*tb->margin;
+}
+
+bool textbox_update(TextBox *tb, SDL_Renderer *ren, TTF_Font *font, int wrap)
+{ // Re-rasterize tb->text only if it changed. Return true if tb->tex was rebuilt.
+    /* *************DOC***************
+     * tb->tex is retained across frames. Most frames the text is
+     * identical to the last frame, so skip TTF and texture upload
+     * and draw the cached texture.
+     *
+     * Init tb->tex to NULL before the first call.
+     * Destroy tb->tex with textbox_free().
+     *
+     * If tb->atlas is set, there is no texture to rebuild. Just
+     * measure the text so fg_rect and bg_rect are the right size.
+     *
+     * Either way, bg_rect is where textbox_draw will draw (see
+     * textbox_layout): use it for dirty rects and layout below it.
+     * *******************************/
+    uint32_t h = text_hash(tb->text, wrap);
+    if(  tb->atlas != NULL  )
+    { // Glyph atlas: re-measure on change
+        if(  (h == tb->hash) && (tb->wrap == wrap)  ) return false;
+        font_atlas_measure(tb->atlas, tb->text, wrap, &tb->fg_rect.w, &tb->fg_rect.h);
+        textbox_layout(tb);
+        tb->wrap = wrap;
+        tb->hash = h;
+        return true;
+    }
+    if(  (tb->tex != NULL) && (h == tb->hash)  ) return false; // Text did not change
+    SDL_Surface *surf = TTF_RenderText_Blended_Wrapped(font, tb->text, tb->fg, wrap);
+    if(  surf == NULL  ) return false;                          // Keep the old texture
+    SDL_DestroyTexture(tb->tex);
+    tb->tex = SDL_CreateTextureFromSurface(ren, surf);
+    SDL_FreeSurface(surf);
+    SDL_QueryTexture(tb->tex, NULL, NULL, &tb->fg_rect.w, &tb->fg_rect.h);
+    textbox_layout(tb);
+    tb->hash = h;
+    return true;
+}
+
+void textbox_draw(TextBox *tb, SDL_Renderer *ren)
+{ // Draw the background box (bg_rect, see textbox_layout), then the text
+    SDL_SetRenderDrawColor(ren, tb->bg.r, tb->bg.g, tb->bg.b, tb->bg.a);
+    SDL_RenderFillRect(ren, &tb->bg_rect);                      // Render bgnd
+    if(  tb->atlas != NULL  )                                   // Render text
+    {
+        font_atlas_draw(tb->atlas, ren, tb->text, tb->fg_rect.x, tb->fg_rect.y, tb->wrap, tb->fg);
+    }
+    else SDL_RenderCopy(ren, tb->tex, NULL, &tb->fg_rect);
+}
 
+void textbox_free(TextBox *tb)
+{
+    SDL_DestroyTexture(tb->tex);
+    tb->tex = NULL;
+}
+
+#endif // __TEXT_H__
@@ -0,0 +1,138 @@
+#ifndef __WATCH_H__
+#define __WATCH_H__
+/* *************Hot reload***************
+ * Reload a sprite sheet when its png (or its layout descriptor, see
+ * layout.h) changes on disk, e.g., after re-exporting from Pixaki.
+ * No restart.
+ *
+ * Example:
+ *      Watch watch; watch_init(&watch, "art");
+ *      while(  quit == false  )
+ *      {
+ *          watch_poll(&watch, &assets);                // Queue changed sheets (does not block)
+ *          for( int id; (id = assets_poll(&assets, ren)) >= 0; ) { ... }
+ *          ...
+ *      }
+ *      watch_free(&watch);
+ *
+ * Only the changed sheet is decoded and analyzed again (on a worker
+ * thread, see assets.h). Then its texture is swapped and characters
+ * playing it keep their frame number if the new sheet still has that
+ * frame (anims_clip_changed).
+ *
+ * Linux: inotify tells us which file in the folder changed.
+ * Elsewhere: check the modification time of every tracked sheet,
+ * WATCH_POLL_MS apart.
+ * *******************************/
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <SDL.h>
+#include "assets.h"
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <limits.h>
+#endif
+
+#define WATCH_POLL_MS 500               // Without inotify: check files this often
+
+typedef struct
+{
+    const char *dir;                    // Folder of sprite sheets, e.g., "art"
+    int fd;                             // inotify instance, or -1
+    time_t mtime[ASSETS_MAX];           // Without inotify: last seen modification time per asset
+    Uint32 last_poll;
+} Watch;
+
+void watch_init(Watch *watch, const char *dir)
+{
+    SDL_zero(*watch);
+    watch->dir = dir;
+    watch->fd = -1;
+#ifdef __linux__
+    watch->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(  (watch->fd >= 0) && (inotify_add_watch(watch->fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO) < 0)  )
+    { // e.g., folder does not exist: fall back to polling
+        close(watch->fd);
+        watch->fd = -1;
+    }
+#endif
+}
+
+int watch_changed(Watch *watch, AssetManager *am, const char *name)
+{ // File name in watch->dir changed: reload it if it is a tracked sheet or its layout. Return 1 if reloaded.
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s", watch->dir, name);
+    const char *dot = strrchr(name, '.');
+    for( int e=0; (dot != NULL) && (e<LAYOUT_NEXT); e++ )
+    { // Descriptor changed: reload its png
+        if(  strcmp(dot+1, layout_ext[e]) == 0  ) snprintf(path, sizeof(path), "%s/%.*s.png", watch->dir, (int)(dot-name), name);
+    }
+    int id = assets_find(am, path);
+    if(  id < 0  ) return 0;
+    printf("Reloading \"%s\"\n", path);
+    assets_reload(am, id);
+    return 1;
+}
+
+time_t watch_mtime(const char *png_path)
+{ // Latest modification time of the png and its layout descriptor, 0 if missing
+    struct stat st;
+    time_t mtime = (stat(png_path, &st) == 0) ? st.st_mtime : 0;
+    char path[256];
+    for( int e=0; (mtime != 0) && (e<LAYOUT_NEXT); e++ )
+    {
+        layout_path(path, sizeof(path), png_path, layout_ext[e]);
+        if(  (stat(path, &st) == 0) && (st.st_mtime > mtime)  ) mtime = st.st_mtime;
+    }
+    return mtime;
+}
+
+int watch_poll(Watch *watch, AssetManager *am)
+{ // Reload sheets that changed since the last call. Return the number of reloads queued.
+    int n = 0;
+#ifdef __linux__
+    if(  watch->fd >= 0  )
+    {
+        _Alignas(struct inotify_event) char buf[4096];
+        ssize_t len;
+        while(  (len = read(watch->fd, buf, sizeof(buf))) > 0  )
+        {
+            for( char *p = buf; p < buf + len; )
+            {
+                const struct inotify_event *ev = (const struct inotify_event *)p;
+                if(  ev->len > 0  ) n += watch_changed(watch, am, ev->name);
+                p += sizeof(struct inotify_event) + ev->len;
+            }
+        }
+        return n;
+    }
+#endif
+    Uint32 now = SDL_GetTicks();
+    if(  now - watch->last_poll < WATCH_POLL_MS  ) return 0;
+    watch->last_poll = now;
+    for( int id=0; id<am->n; id++ )
+    {
+        time_t mtime = watch_mtime(am->asset[id].sprite->path);
+        if(  mtime == 0  ) continue;
+        if(  watch->mtime[id] == 0  ) { watch->mtime[id] = mtime; continue; } // First look
+        if(  mtime == watch->mtime[id]  ) continue;
+        watch->mtime[id] = mtime;
+        printf("Reloading \"%s\"\n", am->asset[id].sprite->path);
+        assets_reload(am, id);
+        n++;
+    }
+    return n;
+}
+
+void watch_free(Watch *watch)
+{
+#ifdef __linux__
+    if(  watch->fd >= 0  ) close(watch->fd);
+#endif
+    watch->fd = -1;
+}
+
+#endif // __WATCH_H__